@@ -0,0 +1,126 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2015 Zoltan Csizmadia (zcsizmadia@gmail.com)
+ *  Copyright (C) 2011 Pulse-Eight (https://www.pulse-eight.com)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "GuideData.h"
+
+#include <algorithm>
+#include <cstring>
+
+std::string_view StringArena::Intern(const std::string& str)
+{
+  m_nRequested += str.size();
+
+  if (str.empty())
+    return std::string_view();
+
+  const auto iter = m_InternTable.find(std::string_view(str));
+  if (iter != m_InternTable.end())
+    return *iter;
+
+  std::string_view view = Allocate(str);
+  m_InternTable.insert(view);
+  return view;
+}
+
+std::string_view StringArena::Allocate(const std::string& str)
+{
+  char* pBuffer;
+
+  if (str.size() > BlockSize / 4)
+  {
+    // Oversized strings get a block of their own so the current block
+    // is not abandoned half empty
+    pBuffer = new char[str.size()];
+    m_Blocks.insert(m_Blocks.end() - (m_Blocks.empty() ? 0 : 1), std::unique_ptr<char[]>(pBuffer));
+    m_nAllocated += str.size();
+  }
+  else
+  {
+    if (m_nBlockUsed + str.size() > BlockSize)
+    {
+      m_Blocks.emplace_back(new char[BlockSize]);
+      m_nBlockUsed = 0;
+      m_nAllocated += BlockSize;
+    }
+    pBuffer = m_Blocks.back().get() + m_nBlockUsed;
+    m_nBlockUsed += str.size();
+  }
+
+  memcpy(pBuffer, str.data(), str.size());
+  return std::string_view(pBuffer, str.size());
+}
+
+void StringArena::ReleaseInternTable()
+{
+  std::unordered_set<std::string_view>().swap(m_InternTable);
+}
+
+size_t StringArena::GetResidentSize() const
+{
+  return m_nAllocated + m_Blocks.capacity() * sizeof(m_Blocks[0]) +
+         m_InternTable.bucket_count() * sizeof(void*) +
+         m_InternTable.size() * (sizeof(std::string_view) + 2 * sizeof(void*));
+}
+
+const GuideChannel* GuideData::FindChannel(const std::string& strGuideNumber) const
+{
+  const auto iter = m_ChannelIndex.find(std::string_view(strGuideNumber));
+  return iter != m_ChannelIndex.end() ? &m_Channels[iter->second] : nullptr;
+}
+
+void GuideData::Seal()
+{
+  m_Arena.ReleaseInternTable();
+
+  m_Channels.shrink_to_fit();
+  for (auto& channel : m_Channels)
+  {
+    std::stable_sort(channel.Entries.begin(), channel.Entries.end(),
+                     [](const GuideEntry& a, const GuideEntry& b) { return a.StartTime < b.StartTime; });
+    channel.Entries.erase(std::unique(channel.Entries.begin(), channel.Entries.end(),
+                                      [](const GuideEntry& a, const GuideEntry& b) { return a.StartTime == b.StartTime; }),
+                          channel.Entries.end());
+
+    // Lookups rely on entries not overlapping, cut an entry short where the next one starts
+    for (size_t nEntry = 0; nEntry + 1 < channel.Entries.size(); nEntry++)
+    {
+      GuideEntry& entry = channel.Entries[nEntry];
+      entry.EndTime = std::min(std::max(entry.EndTime, entry.StartTime), channel.Entries[nEntry + 1].StartTime);
+    }
+
+    channel.Entries.shrink_to_fit();
+  }
+
+  // The first channel with a guide number wins, as it did for a linear search
+  m_ChannelIndex.clear();
+  m_ChannelIndex.reserve(m_Channels.size());
+  for (size_t nChannel = 0; nChannel < m_Channels.size(); nChannel++)
+    m_ChannelIndex.emplace(m_Channels[nChannel].GuideNumber, nChannel);
+}
+
+size_t GuideData::GetEntryCount() const
+{
+  size_t nCount = 0;
+  for (const auto& channel : m_Channels)
+    nCount += channel.Entries.size();
+
+  return nCount;
+}
+
+size_t GuideData::GetResidentSize() const
+{
+  size_t nSize = sizeof(*this) + m_Arena.GetResidentSize() +
+                 m_Channels.capacity() * sizeof(GuideChannel) +
+                 m_ChannelIndex.bucket_count() * sizeof(void*) +
+                 m_ChannelIndex.size() * (sizeof(std::string_view) + sizeof(size_t) + 2 * sizeof(void*));
+  for (const auto& channel : m_Channels)
+    nSize += channel.Entries.capacity() * sizeof(GuideEntry);
+
+  return nSize;
+}
@@ -0,0 +1,108 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2015 Zoltan Csizmadia (zcsizmadia@gmail.com)
+ *  Copyright (C) 2011 Pulse-Eight (https://www.pulse-eight.com)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <ctime>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <kodi/AddonBase.h>
+#include <kodi/addon-instance/PVR.h>
+
+// Bump allocator for the strings of one guide generation. Memory is only
+// ever released as a whole, when the arena itself is destroyed.
+class ATTR_DLL_LOCAL StringArena
+{
+public:
+  StringArena() = default;
+  StringArena(const StringArena&) = delete;
+  StringArena& operator=(const StringArena&) = delete;
+
+  // Returns a view of an arena-owned copy of str, shared with any previous
+  // identical string stored in this arena
+  std::string_view Intern(const std::string& str);
+
+  // Drops the lookup table used by Intern(); the stored strings stay valid
+  void ReleaseInternTable();
+
+  size_t GetResidentSize() const;
+  size_t GetRequestedSize() const { return m_nRequested; }
+
+private:
+  std::string_view Allocate(const std::string& str);
+
+  static constexpr size_t BlockSize = 64 * 1024;
+
+  std::vector<std::unique_ptr<char[]>> m_Blocks;
+  size_t m_nBlockUsed = BlockSize;
+  size_t m_nAllocated = 0;
+  size_t m_nRequested = 0;
+  std::unordered_set<std::string_view> m_InternTable;
+};
+
+struct GuideEntry
+{
+  std::string_view Title;
+  std::string_view EpisodeTitle;
+  std::string_view Synopsis;
+  std::string_view ImageURL;
+  std::string_view SeriesID;
+  std::string_view FirstAired;
+  time_t StartTime = 0;
+  time_t EndTime = 0;
+  time_t OriginalAirdate = 0;
+  unsigned int UID = 0;
+  unsigned int GenreType = 0;
+  int SeriesNumber = EPG_TAG_INVALID_SERIES_EPISODE;
+  int EpisodeNumber = EPG_TAG_INVALID_SERIES_EPISODE;
+  // First aired within two days of the start time, marked when read if mark_new is set
+  bool New = false;
+};
+
+struct GuideChannel
+{
+  std::string_view GuideNumber;
+  std::string_view Affiliate;
+  std::string_view ImageURL;
+  std::vector<GuideEntry> Entries;
+};
+
+// One refresh generation of a device's guide. All strings live in the
+// generation's arena, so superseding a generation frees it in one shot.
+class ATTR_DLL_LOCAL GuideData
+{
+public:
+  std::string_view Intern(const std::string& str) { return m_Arena.Intern(str); }
+
+  std::vector<GuideChannel>& GetChannels() { return m_Channels; }
+  const std::vector<GuideChannel>& GetChannels() const { return m_Channels; }
+
+  // Only finds channels of a sealed generation
+  const GuideChannel* FindChannel(const std::string& strGuideNumber) const;
+
+  // Called once the generation is fully populated; sorts each channel's
+  // entries by start time so lookups can binary search the requested window
+  // and drops entries repeating a start time, which is their broadcast ID.
+  // Also indexes the channels by guide number.
+  void Seal();
+
+  size_t GetEntryCount() const;
+  size_t GetResidentSize() const;
+  size_t GetStringSize() const { return m_Arena.GetRequestedSize(); }
+
+private:
+  StringArena m_Arena;
+  std::vector<GuideChannel> m_Channels;
+  std::unordered_map<std::string_view, size_t> m_ChannelIndex;
+};
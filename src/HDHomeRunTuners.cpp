@@ -8,19 +8,114 @@
  */
 
 #include "HDHomeRunTuners.h"
+#include "StreamRate.h"
 #include "Utils.h"
 
 #include <kodi/Filesystem.h>
 #include <kodi/tools/StringUtils.h>
-#include <set>
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <numeric>
+#include <sstream>
 
 static const std::string g_strGroupFavoriteChannels("Favorite channels");
 static const std::string g_strGroupHDChannels("HD channels");
 static const std::string g_strGroupSDChannels("SD channels");
 
+// Fixed profiles of the transcode setting, in the order of its options after "automatic"
+static const char* const g_TranscodeProfiles[] = {"heavy", "mobile", "internet720", "internet540",
+                                                  "internet480", "internet360", "internet240"};
+
+// Reads the transcode profiles from the device's feature list. Returns false
+// if the device could not be reached, a device without the feature is known.
+static bool GetTranscodeProfiles(const hdhomerun_discover_device_t& device, std::vector<std::string>& profiles)
+{
+  profiles.clear();
+
+  hdhomerun_device_t* hd = hdhomerun_device_create(
+      device.device_id != 0 ? device.device_id : HDHOMERUN_DEVICE_ID_WILDCARD, device.ip_addr, 0, nullptr);
+  if (hd == nullptr)
+    return false;
+
+  char* pValue = nullptr;
+  char* pError = nullptr;
+  const int nResult = hdhomerun_device_get_var(hd, "/sys/features", &pValue, &pError);
+
+  if (nResult > 0 && pValue != nullptr)
+  {
+    // One "feature: value value ..." line per feature
+    std::istringstream features(pValue);
+    std::string strLine, strProfile;
+
+    while (std::getline(features, strLine))
+    {
+      if (strLine.compare(0, 10, "transcode:") != 0)
+        continue;
+
+      std::istringstream values(strLine.substr(10));
+      while (values >> strProfile)
+        profiles.push_back(strProfile);
+    }
+  }
+
+  hdhomerun_device_destroy(hd);
+  return nResult >= 0;
+}
+
+// Opens a stream to check the device can serve it, returns false if no request
+// could be made. If pRate is given, the start of the stream is read into it;
+// timing starts after the first data as tuning takes a while.
+static bool ProbeStream(const std::string& strUrl, int& returnCode, StreamRate* pRate)
+{
+  kodi::vfs::CFile fileHandle;
+
+  returnCode = -1;
+  if (!fileHandle.CURLCreate(strUrl))
+    return false;
+
+  fileHandle.CURLAddOption(ADDON_CURL_OPTION_PROTOCOL , "failonerror", "false");
+  fileHandle.CURLAddOption(ADDON_CURL_OPTION_PROTOCOL, "connection-timeout", "5");
+
+  if (fileHandle.CURLOpen(ADDON_READ_NO_CACHE))
+  {
+    std::string proto = fileHandle.GetPropertyValue(ADDON_FILE_PROPERTY_RESPONSE_PROTOCOL, "");
+    std::string::size_type posResponseCode = proto.find(' ');
+    if (posResponseCode != std::string::npos)
+      returnCode = atoi(proto.c_str() + (posResponseCode + 1));
+
+    if (pRate != nullptr && returnCode >= 200 && returnCode < 400)
+    {
+      std::vector<char> buffer(64 * 1024);
+
+      if (fileHandle.Read(buffer.data(), buffer.size()) > 0)
+      {
+        const auto end = StreamRate::Clock::now() + std::chrono::milliseconds(HDHomeRunTuners::ThroughputSampleTimeMs);
+        size_t nTotal = 0;
+        ssize_t nRead;
+
+        while (nTotal < HDHomeRunTuners::ThroughputSampleSize && StreamRate::Clock::now() < end &&
+               (nRead = fileHandle.Read(buffer.data(), buffer.size())) > 0)
+        {
+          pRate->Add(buffer.data(), static_cast<size_t>(nRead), StreamRate::Clock::now());
+          nTotal += nRead;
+        }
+      }
+    }
+  }
+  fileHandle.Close();
+
+  return true;
+}
+
 HDHomeRunTuners::~HDHomeRunTuners()
 {
-  m_running = false;
+  {
+    std::lock_guard<std::mutex> lock(m_ProcessLock);
+    m_running = false;
+  }
+  m_ProcessCondition.notify_all();
+
   if (m_thread.joinable())
     m_thread.join();
 }
@@ -30,6 +125,12 @@ ADDON_STATUS HDHomeRunTuners::Create()
   KODI_LOG(ADDON_LOG_INFO, "%s - Creating the PVR HDHomeRun add-on", __FUNCTION__);
 
   SettingsType::Get().ReadSettings();
+
+  const std::string strUserPath = kodi::addon::GetUserPath();
+  if (!kodi::vfs::DirectoryExists(strUserPath))
+    kodi::vfs::CreateDirectory(strUserPath);
+  m_ChannelIds = std::make_unique<IdRegistry>(kodi::addon::GetUserPath("channelids.json"));
+
   Update();
   m_running = true;
   m_thread = std::thread([&] { Process(); });
@@ -39,32 +140,146 @@ ADDON_STATUS HDHomeRunTuners::Create()
 
 ADDON_STATUS HDHomeRunTuners::SetSetting(const std::string& settingName, const kodi::addon::CSettingValue& settingValue)
 {
-  return SettingsType::Get().SetSetting(settingName, settingValue);
+  const ADDON_STATUS status = SettingsType::Get().SetSetting(settingName, settingValue);
+
+  // Nothing to reapply yet, Create() reads the settings itself
+  if (!m_running)
+    return status;
+
+  if (settingName == "hide_protected" || settingName == "hide_duplicate")
+  {
+    // The filters are applied when the channels are built from the cached lineups and guides
+    {
+      AutoLock l(this);
+      UpdateChannels();
+    }
+    SaveChannelIds();
+
+    kodi::addon::CInstancePVRClient::TriggerChannelUpdate();
+    kodi::addon::CInstancePVRClient::TriggerChannelGroupsUpdate();
+  }
+  else if (settingName == "mark_new")
+  {
+    // Titles are marked when the guide is read, only the channels with guide data change
+    std::vector<unsigned int> channelUids;
+
+    {
+      AutoLock l(this);
+
+      for (const auto& channel : m_Channels)
+        if (channel.pGuideChannel)
+          channelUids.push_back(channel.UID);
+    }
+
+    for (const auto& uid : channelUids)
+      kodi::addon::CInstancePVRClient::TriggerEpgUpdate(uid);
+  }
+  else if (settingName == "http_discovery")
+  {
+    // Discovery goes to the network, leave it to the add-on's own thread
+    {
+      std::lock_guard<std::mutex> lock(m_ProcessLock);
+      m_bRediscoverPending = true;
+    }
+    m_ProcessCondition.notify_all();
+  }
+
+  return status;
 }
 
 void HDHomeRunTuners::Process()
 {
-  for (;;)
+  // The first sync fetches every series of every engine, keep it off Kodi's thread
+  if (UpdateRecordEngines())
+    kodi::addon::CInstancePVRClient::TriggerRecordingUpdate();
+
+  // Writing the ring file once is too slow for the player's open path
+  const SettingsType& settings = SettingsType::Get();
+  if (settings.GetTimeshift())
+    m_bTimeshiftReady = TimeshiftBuffer::Prepare(settings.GetTimeshiftPath(), settings.GetTimeshiftBufferSize(), m_running);
+
+  std::unique_lock<std::mutex> lock(m_ProcessLock);
+
+  for (int nPass = 1; m_running; nPass++)
   {
-    for (int i = 0; i < 60*60; i++)
-    {
-      std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-      if (!m_running)
-        break;
-    }
+    m_ProcessCondition.wait_for(lock, std::chrono::seconds(RecordingsUpdateInterval),
+                                [this] { return !m_running || m_bWakePending || m_bRediscoverPending; });
 
     if (!m_running)
       break;
 
-    if (Update(HDHomeRunTuners::UpdateLineUp | HDHomeRunTuners::UpdateGuide))
+    lock.unlock();
+
+    if (m_bWakePending.exchange(false))
+    {
+      m_bRediscoverPending = false;
+      RediscoverAfterWake();
+      nPass = 0;
+    }
+    else if (m_bRediscoverPending.exchange(false))
+    {
+      // Only newly found devices have their lineup and guide fetched, the
+      // discovery method applies to record engines as well
+      if (Update(HDHomeRunTuners::UpdateDiscover))
+        kodi::addon::CInstancePVRClient::TriggerChannelUpdate();
+
+      if (UpdateRecordEngines())
+        kodi::addon::CInstancePVRClient::TriggerRecordingUpdate();
+    }
+    else
+    {
+      if (UpdateRecordEngines())
+        kodi::addon::CInstancePVRClient::TriggerRecordingUpdate();
+
+      if (nPass % UpdatePassesPerGuideUpdate == 0)
+      {
+        if (Update(HDHomeRunTuners::UpdateLineUp | HDHomeRunTuners::UpdateGuide))
+          kodi::addon::CInstancePVRClient::TriggerChannelUpdate();
+
+        LogStats();
+      }
+    }
+
+    lock.lock();
+  }
+}
+
+void HDHomeRunTuners::RediscoverAfterWake()
+{
+  // The network is often not back yet when the wake is signalled; retry the
+  // discovery with exponential backoff, the last known state stays in use meanwhile
+  for (int nDelay = 1;; nDelay *= 2)
+  {
+    if (Update())
+    {
       kodi::addon::CInstancePVRClient::TriggerChannelUpdate();
+      break;
+    }
+
+    if (nDelay > MaxWakeRetryDelay)
+    {
+      KODI_LOG(ADDON_LOG_INFO, "No HDHomeRun devices found after wake, keeping the last known channels");
+      break;
+    }
+
+    KODI_LOG(ADDON_LOG_DEBUG, "No HDHomeRun devices found after wake, retrying in %d seconds", nDelay);
+
+    std::unique_lock<std::mutex> lock(m_ProcessLock);
+    if (m_ProcessCondition.wait_for(lock, std::chrono::seconds(nDelay), [this] { return !m_running; }))
+      return;
   }
+
+  if (UpdateRecordEngines())
+    kodi::addon::CInstancePVRClient::TriggerRecordingUpdate();
 }
 
-unsigned int HDHomeRunTuners::PvrCalculateUniqueId(const std::string& str)
+void HDHomeRunTuners::LogStats()
 {
-  int nHash = (int)std::hash<std::string>()(str);
-  return (unsigned int)abs(nHash);
+  m_Lock.LogStats();
+  m_GetChannelsStats.Log();
+  m_GetEPGForChannelStats.Log();
+  m_GetChannelGroupMembersStats.Log();
+  m_GetChannelStreamURLStats.Log();
 }
 
 PVR_ERROR HDHomeRunTuners::GetCapabilities(kodi::addon::PVRCapabilities& capabilities)
@@ -73,13 +288,14 @@ PVR_ERROR HDHomeRunTuners::GetCapabilities(kodi::addon::PVRCapabilities& capabil
   capabilities.SetSupportsTV(true);
   capabilities.SetSupportsRadio(false);
   capabilities.SetSupportsChannelGroups(true);
-  capabilities.SetSupportsRecordings(false);
+  capabilities.SetSupportsRecordings(true);
   capabilities.SetSupportsRecordingsDelete(false);
   capabilities.SetSupportsRecordingsUndelete(false);
   capabilities.SetSupportsTimers(false);
   capabilities.SetSupportsRecordingsRename(false);
   capabilities.SetSupportsRecordingsLifetimeChange(false);
   capabilities.SetSupportsDescrambleInfo(false);
+  capabilities.SetHandlesInputStream(SettingsType::Get().GetTimeshift());
 
   return PVR_ERROR_NO_ERROR;
 }
@@ -104,60 +320,83 @@ PVR_ERROR HDHomeRunTuners::GetConnectionString(std::string& connection)
 
 PVR_ERROR HDHomeRunTuners::GetDriveSpace(uint64_t& total, uint64_t& used)
 {
-  total = 1024 * 1024 * 1024;
+  total = 0;
   used = 0;
+
+  AutoLock l(this);
+
+  for (const auto& engine : m_RecordEngines)
+  {
+    if (engine.IsStale())
+      continue;
+
+    total += engine.GetTotalSpace() / 1024;
+    used += (engine.GetTotalSpace() - std::min(engine.GetFreeSpace(), engine.GetTotalSpace())) / 1024;
+  }
+
+  if (total == 0)
+    total = 1024 * 1024 * 1024;
+
   return PVR_ERROR_NO_ERROR;
 }
 
 PVR_ERROR HDHomeRunTuners::OnSystemWake()
 {
-  Update(HDHomeRunTuners::UpdateLineUp | HDHomeRunTuners::UpdateGuide);
-  kodi::addon::CInstancePVRClient::TriggerChannelUpdate();
+  // Handled on the add-on's own thread, Kodi's callback thread must not block on the network
+  {
+    std::lock_guard<std::mutex> lock(m_ProcessLock);
+    m_bWakePending = true;
+  }
+  m_ProcessCondition.notify_all();
+
   return PVR_ERROR_NO_ERROR;
 }
 
-int HDHomeRunTuners::DiscoverTunersViaHttp(struct hdhomerun_discover_device_t* tuners,
-                                           int maxtuners)
+int HDHomeRunTuners::DiscoverDevicesViaHttp(uint32_t devicetype,
+                                            struct hdhomerun_discover_device_t* devices,
+                                            int maxdevices)
 {
-  int numtuners = 0;
+  int numdevices = 0;
 
   std::string strJson, jsonReaderError;
   Json::CharReaderBuilder jsonReaderBuilder;
   std::unique_ptr<Json::CharReader> const jsonReader(jsonReaderBuilder.newCharReader());
 
+  // Tuners are identified by the presence of a DeviceID value in the JSON, storage
+  // engines (DVR) by a StorageID; devices with both tuners and a storage engine have both
+  const char* idkey = (devicetype == HDHOMERUN_DEVICE_TYPE_STORAGE) ? "StorageID" : "DeviceID";
+
   // This API may be removed by the provider in the future without notice; treat an inability
-  // to access this URL as if there were no tuners discovered.  Update() will then attempt
-  // a normal broadcast discovery and try to find the user's tuner devices that way
+  // to access this URL as if there were no devices discovered.  Update() will then attempt
+  // a normal broadcast discovery and try to find the user's devices that way
   if (GetFileContents("https://api.hdhomerun.com/discover", strJson))
   {
-    Json::Value devices;
-    if (jsonReader->parse(strJson.c_str(), strJson.c_str() + strJson.size(), &devices,
+    Json::Value jsonDevices;
+    if (jsonReader->parse(strJson.c_str(), strJson.c_str() + strJson.size(), &jsonDevices,
                           &jsonReaderError) &&
-        devices.type() == Json::arrayValue)
+        jsonDevices.type() == Json::arrayValue)
     {
-      for (const auto& device : devices)
+      for (const auto& device : jsonDevices)
       {
-        // Tuners are identified by the presence of a DeviceID value in the JSON;
-        // this also applies to devices that have both tuners and a storage engine (DVR)
-        if (!device["DeviceID"].isNull() && !device["LocalIP"].isNull())
+        if (!device[idkey].isNull() && !device["LocalIP"].isNull())
         {
           std::string ipstring = device["LocalIP"].asString();
           if (ipstring.length() > 0)
           {
             uint32_t ip = ntohl(inet_addr(ipstring.c_str()));
-            numtuners += hdhomerun_discover_find_devices_custom_v2(
-                ip, HDHOMERUN_DEVICE_TYPE_TUNER, HDHOMERUN_DEVICE_ID_WILDCARD, &tuners[numtuners],
-                maxtuners - numtuners);
+            numdevices += hdhomerun_discover_find_devices_custom_v2(
+                ip, devicetype, HDHOMERUN_DEVICE_ID_WILDCARD, &devices[numdevices],
+                maxdevices - numdevices);
           }
         }
 
-        if (numtuners == maxtuners)
+        if (numdevices == maxdevices)
           break;
       }
     }
   }
 
-  return numtuners;
+  return numdevices;
 }
 
 bool HDHomeRunTuners::Update(int nMode)
@@ -174,7 +413,7 @@ bool HDHomeRunTuners::Update(int nMode)
   // methods mutually exclusive
 
   if (SettingsType::Get().GetHttpDiscovery())
-    nTunerCount = DiscoverTunersViaHttp(foundDevices, 16);
+    nTunerCount = DiscoverDevicesViaHttp(HDHOMERUN_DEVICE_TYPE_TUNER, foundDevices, 16);
 
   if (nTunerCount <= 0)
     nTunerCount = hdhomerun_discover_find_devices_custom_v2(
@@ -188,81 +427,113 @@ bool HDHomeRunTuners::Update(int nMode)
   std::string strUrl, strJson, jsonReaderError;
   Json::CharReaderBuilder jsonReaderBuilder;
   std::unique_ptr<Json::CharReader> const jsonReader(jsonReaderBuilder.newCharReader());
-  std::set<std::string> guideNumberSet;
-  bool bClearTuners = false;
 
-  AutoLock l(this);
+  // Refreshes are serialised and build their result outside m_Lock, so the
+  // API calls are only blocked while the new state is published. As only
+  // refreshes modify m_Tuners, it can be read here without m_Lock.
+  std::lock_guard<std::mutex> updateLock(m_UpdateLock);
+  std::vector<Tuner> tuners = m_Tuners;
+  const time_t now = time(nullptr);
 
-  // if latest discovery found fewer devices than m_Tuners List, clear and start fresh
-  if (nMode & UpdateDiscover || nTunerCount < m_Tuners.size())
-  {
-    bClearTuners = true;
-    m_Tuners.clear();
-  }
+  // Devices missing from this discovery stay stale until they show up again
+  for (auto& tuner : tuners)
+    tuner.Stale = true;
 
   for (int nTunerIndex = 0; nTunerIndex < nTunerCount; nTunerIndex++)
   {
+    const hdhomerun_discover_device_t& device = foundDevices[nTunerIndex];
     Tuner* pTuner = nullptr;
 
-    if (bClearTuners)
-    {
-      // New device
-      Tuner tuner;
-      pTuner = &*m_Tuners.insert(m_Tuners.end(), tuner);
-    }
-    else
-    {
-      // Find existing device
-      for (auto& iter : m_Tuners)
-        if (iter.Device.ip_addr == foundDevices[nTunerIndex].ip_addr)
-        {
-          pTuner = &iter;
-          break;
-        }
-
-      // Device not found in m_Tuners, Add it.
-      if (pTuner == nullptr)
+    // Find existing device; the device ID survives an address change after a wake
+    for (auto& iter : tuners)
+      if ((device.device_id != 0 && iter.Device.device_id == device.device_id) ||
+          (device.device_id == 0 && iter.Device.ip_addr == device.ip_addr))
       {
-        Tuner tuner;
-        pTuner = &*m_Tuners.insert(m_Tuners.end(), tuner);
+        pTuner = &iter;
+        break;
       }
+
+    // Device not found in m_Tuners, Add it.
+    int nTunerMode = nMode;
+    if (pTuner == nullptr)
+    {
+      Tuner tuner;
+      pTuner = &*tuners.insert(tuners.end(), tuner);
+      nTunerMode |= UpdateLineUp | UpdateGuide;
     }
 
     //
     // Update device
     //
-    pTuner->Device = foundDevices[nTunerIndex];
+    pTuner->Device = device;
+    pTuner->Stale = false;
+    pTuner->LastSeen = now;
+
+    if (!pTuner->FeaturesKnown)
+    {
+      pTuner->FeaturesKnown = GetTranscodeProfiles(device, pTuner->TranscodeProfiles);
+      if (!pTuner->TranscodeProfiles.empty())
+        KODI_LOG(ADDON_LOG_DEBUG, "Tuner ID: %08X supports %u transcode profiles", device.device_id,
+                 static_cast<unsigned int>(pTuner->TranscodeProfiles.size()));
+    }
 
     //
     // Guide
     //
-    if (nMode & UpdateGuide)
+    if (nTunerMode & UpdateGuide)
     {
       strUrl = kodi::tools::StringUtils::Format("https://my.hdhomerun.com/api/guide.php?DeviceAuth=%s", EncodeURL(pTuner->Device.device_auth).c_str());
       KODI_LOG(ADDON_LOG_DEBUG, "Requesting HDHomeRun guide: %s", strUrl.c_str());
 
-      if (GetFileContents(strUrl.c_str(), strJson))
+      // The guide is by far the largest download, allow it more time
+      if (GetFileContents(strUrl.c_str(), strJson, 60))
       {
-        if (jsonReader->parse(strJson.c_str(), strJson.c_str() + strJson.size(), &pTuner->Guide, &jsonReaderError) &&
-          pTuner->Guide.type() == Json::arrayValue)
+        Json::Value jsonTunerGuide;
+
+        if (jsonReader->parse(strJson.c_str(), strJson.c_str() + strJson.size(), &jsonTunerGuide, &jsonReaderError) &&
+          jsonTunerGuide.type() == Json::arrayValue)
         {
-          for (auto& tunerGuide : pTuner->Guide)
+          // Build a new generation; the previous one is released as a whole once replaced
+          std::shared_ptr<GuideData> guide = std::make_shared<GuideData>();
+          guide->GetChannels().reserve(jsonTunerGuide.size());
+
+          for (const auto& tunerGuide : jsonTunerGuide)
           {
-            Json::Value& jsonGuide = tunerGuide["Guide"];
+            GuideChannel& guideChannel = guide->GetChannels().emplace_back();
+
+            guideChannel.GuideNumber = guide->Intern(tunerGuide["GuideNumber"].asString());
+            guideChannel.Affiliate = guide->Intern(tunerGuide["Affiliate"].asString());
+            guideChannel.ImageURL = guide->Intern(tunerGuide["ImageURL"].asString());
+
+            const Json::Value& jsonGuide = tunerGuide["Guide"];
 
             if (jsonGuide.type() != Json::arrayValue)
               continue;
 
-            for (auto& jsonGuideItem : jsonGuide)
-            {
-              int iSeriesNumber = EPG_TAG_INVALID_SERIES_EPISODE, iEpisodeNumber = EPG_TAG_INVALID_SERIES_EPISODE;
-
-              jsonGuideItem["_UID"] = PvrCalculateUniqueId(jsonGuideItem["Title"].asString() + jsonGuideItem["EpisodeNumber"].asString() + jsonGuideItem["ImageURL"].asString());
+            guideChannel.Entries.reserve(jsonGuide.size());
 
-              if (SettingsType::Get().GetMarkNew() &&
-                  jsonGuideItem["OriginalAirdate"].asUInt() != 0 &&
-                  jsonGuideItem["OriginalAirdate"].asUInt() + 48*60*60 > jsonGuideItem["StartTime"].asUInt())
-                jsonGuideItem["Title"] = "*" + jsonGuideItem["Title"].asString();
+            for (const auto& jsonGuideItem : jsonGuide)
+            {
+              GuideEntry& guideEntry = guideChannel.Entries.emplace_back();
+              const std::string strEpisodeNumber = jsonGuideItem["EpisodeNumber"].asString();
+
+              guideEntry.StartTime = static_cast<time_t>(jsonGuideItem["StartTime"].asUInt());
+              // Broadcast IDs only need to be unique per channel; the start time is, and
+              // unlike a hash of the event's details it stays put when those are edited
+              guideEntry.UID = jsonGuideItem["StartTime"].asUInt();
+              guideEntry.EndTime = static_cast<time_t>(jsonGuideItem["EndTime"].asUInt());
+              guideEntry.OriginalAirdate = static_cast<time_t>(jsonGuideItem["OriginalAirdate"].asUInt());
+
+              guideEntry.New = guideEntry.OriginalAirdate != 0 &&
+                               guideEntry.OriginalAirdate + 48*60*60 > guideEntry.StartTime;
+
+              guideEntry.Title = guide->Intern(jsonGuideItem["Title"].asString());
+              guideEntry.EpisodeTitle = guide->Intern(jsonGuideItem["EpisodeTitle"].asString());
+              guideEntry.Synopsis = guide->Intern(jsonGuideItem["Synopsis"].asString());
+              guideEntry.ImageURL = guide->Intern(jsonGuideItem["ImageURL"].asString());
+              guideEntry.SeriesID = guide->Intern(jsonGuideItem["SeriesID"].asString());
+              if (guideEntry.OriginalAirdate > 0)
+                guideEntry.FirstAired = guide->Intern(ParseAsW3CDateString(guideEntry.OriginalAirdate));
 
               unsigned int nGenreType = 0;
               for (const auto& str : jsonGuideItem["Filter"])
@@ -286,19 +557,20 @@ bool HDHomeRunTuners::Update(int nMode)
                          str == "Sports")
                   nGenreType = EPG_EVENT_CONTENTMASK_SPORTS;
               }
-              jsonGuideItem["_GenreType"] = nGenreType;
-
-              if (sscanf(jsonGuideItem["EpisodeNumber"].asString().c_str(), "S%dE%d", &iSeriesNumber, &iEpisodeNumber) != 2)
-                if (sscanf(jsonGuideItem["EpisodeNumber"].asString().c_str(), "EP%d-%d", &iSeriesNumber, &iEpisodeNumber) != 2)
-                  if (sscanf(jsonGuideItem["EpisodeNumber"].asString().c_str(), "EP%d", &iEpisodeNumber) == 1)
-                    iSeriesNumber = EPG_TAG_INVALID_SERIES_EPISODE;
+              guideEntry.GenreType = nGenreType;
 
-              jsonGuideItem["_SeriesNumber"] = iSeriesNumber;
-              jsonGuideItem["_EpisodeNumber"] = iEpisodeNumber;
+              ParseEpisodeNumber(strEpisodeNumber, guideEntry.SeriesNumber, guideEntry.EpisodeNumber);
             }
           }
 
-          KODI_LOG(ADDON_LOG_DEBUG, "Found %u guide entries", pTuner->Guide.size());
+          guide->Seal();
+
+          KODI_LOG(ADDON_LOG_DEBUG, "Found %u guide entries", static_cast<unsigned int>(guide->GetEntryCount()));
+          KODI_LOG(ADDON_LOG_DEBUG, "Guide uses %u bytes resident (%u bytes of strings before interning)",
+                   static_cast<unsigned int>(guide->GetResidentSize()),
+                   static_cast<unsigned int>(guide->GetStringSize()));
+
+          pTuner->Guide = std::move(guide);
         }
         else
         {
@@ -310,7 +582,7 @@ bool HDHomeRunTuners::Update(int nMode)
     //
     // Lineup
     //
-    if (nMode & UpdateLineUp)
+    if (nTunerMode & UpdateLineUp)
     {
       strUrl = kodi::tools::StringUtils::Format("%s/lineup.json", pTuner->Device.base_url);
 
@@ -318,103 +590,327 @@ bool HDHomeRunTuners::Update(int nMode)
 
       if (GetFileContents(strUrl.c_str(), strJson))
       {
-        if (jsonReader->parse(strJson.c_str(), strJson.c_str() + strJson.size(), &pTuner->LineUp, &jsonReaderError) &&
-          pTuner->LineUp.type() == Json::arrayValue)
+        Json::Value jsonLineUp;
+
+        if (jsonReader->parse(strJson.c_str(), strJson.c_str() + strJson.size(), &jsonLineUp, &jsonReaderError) &&
+          jsonLineUp.type() == Json::arrayValue)
         {
-          int nChannelNumber = 1;
+          pTuner->LineUp.clear();
+          pTuner->LineUp.reserve(jsonLineUp.size());
 
-          for (auto& jsonChannel : pTuner->LineUp)
+          for (const auto& jsonChannel : jsonLineUp)
           {
-            bool bHide =
-              ((jsonChannel["DRM"].asBool() && SettingsType::Get().GetHideProtected()) ||
-               (SettingsType::Get().GetHideDuplicateChannels() && guideNumberSet.find(jsonChannel["GuideNumber"].asString()) != guideNumberSet.end()));
-
-            jsonChannel["_UID"] = PvrCalculateUniqueId(jsonChannel["GuideName"].asString() + jsonChannel["URL"].asString());
-            jsonChannel["_ChannelName"] = jsonChannel["GuideName"].asString();
-
-            // Find guide entry
-            for (const auto& jsonGuide : pTuner->Guide)
-            {
-              if (jsonGuide["GuideNumber"].asString() == jsonChannel["GuideNumber"].asString())
-              {
-                if (jsonGuide["Affiliate"].asString() != "")
-                  jsonChannel["_ChannelName"] = jsonGuide["Affiliate"].asString();
-                jsonChannel["_IconPath"] = jsonGuide["ImageURL"].asString();
-                break;
-              }
-            }
-
-            jsonChannel["_Hide"] = bHide;
-
-            int nChannel = 0, nSubChannel = 0;
-            if (sscanf(jsonChannel["GuideNumber"].asString().c_str(), "%d.%d", &nChannel, &nSubChannel) != 2)
-            {
-              nSubChannel = 0;
-              if (sscanf(jsonChannel["GuideNumber"].asString().c_str(), "%d", &nChannel) != 1)
-                nChannel = nChannelNumber;
-            }
-            jsonChannel["_ChannelNumber"] = nChannel;
-            jsonChannel["_SubChannelNumber"] = nSubChannel;
-
-            if (!bHide)
-            {
-              guideNumberSet.insert(jsonChannel["GuideNumber"].asString());
-              nChannelNumber++;
-            }
+            LineUpEntry& entry = pTuner->LineUp.emplace_back();
+
+            entry.GuideNumber = jsonChannel["GuideNumber"].asString();
+            entry.GuideName = jsonChannel["GuideName"].asString();
+            entry.URL = jsonChannel["URL"].asString();
+            entry.DRM = jsonChannel["DRM"].asBool();
+            entry.HD = jsonChannel["HD"].asBool();
+            entry.Favorite = jsonChannel["Favorite"].asBool();
           }
-          KODI_LOG(ADDON_LOG_DEBUG, "Found %u channels", pTuner->LineUp.size());
+          KODI_LOG(ADDON_LOG_DEBUG, "Found %u channels", static_cast<unsigned int>(pTuner->LineUp.size()));
         }
         else
           KODI_LOG(ADDON_LOG_ERROR, "Failed to parse lineup", strUrl.c_str());
       }
     }
   }
+
+  // Keep the lineup and guide of devices missing only temporarily, e.g. while
+  // the network comes back after a wake, rather than making channels vanish
+  const size_t nTuners = tuners.size();
+  tuners.erase(std::remove_if(tuners.begin(), tuners.end(),
+                              [now](const Tuner& tuner) { return tuner.Stale && now - tuner.LastSeen > StaleDeviceTimeout; }),
+               tuners.end());
+
+  if (tuners.size() != nTuners)
+    KODI_LOG(ADDON_LOG_DEBUG, "Dropped %u devices missing for too long", static_cast<unsigned int>(nTuners - tuners.size()));
+
+  {
+    AutoLock l(this);
+
+    m_Tuners.swap(tuners);
+    UpdateChannels();
+  }
+
+  SaveChannelIds();
+
   return true;
 }
 
-PVR_ERROR HDHomeRunTuners::GetChannelsAmount(int& amount)
+void HDHomeRunTuners::UpdateChannels()
 {
-  amount = 0;
+  using Copy = std::pair<const Tuner*, const LineUpEntry*>;
+
+  // Collect every device's copy of each station, in discovery order. A station
+  // is identified by number and name, devices on different sources (cable and
+  // antenna) can carry different stations under the same number.
+  std::vector<std::string> stationKeys;
+  std::unordered_map<std::string, std::vector<Copy>> stations;
+
+  // Stale devices go last so failover prefers the devices that are reachable
+  for (const bool bStale : {false, true})
+    for (const auto& iterTuner : m_Tuners)
+    {
+      if (iterTuner.Stale != bStale)
+        continue;
+
+      for (const auto& entry : iterTuner.LineUp)
+      {
+        if (entry.DRM && SettingsType::Get().GetHideProtected())
+          continue;
+
+        const std::string strStationKey = entry.GuideNumber + "|" + entry.GuideName;
+        std::vector<Copy>& copies = stations[strStationKey];
+        if (copies.empty())
+          stationKeys.push_back(strStationKey);
+        copies.emplace_back(&iterTuner, &entry);
+      }
+    }
+
+  const bool bMerge = SettingsType::Get().GetHideDuplicateChannels();
+  unsigned int nChannelNumber = 1;
+
+  m_Channels.clear();
+  m_ChannelIndex.clear();
+
+  for (const auto& strStationKey : stationKeys)
+  {
+    const std::vector<Copy>& copies = stations[strStationKey];
+    const std::string& strGuideNumber = copies.front().second->GuideNumber;
+
+    // Merged stations become one channel; otherwise every copy is its own
+    // channel, still failing over to the other devices' copies. Unmerged
+    // copies are ordered by device ID so the IDs do not follow discovery order.
+    std::vector<size_t> channelCopies(bMerge ? 1 : copies.size());
+    std::iota(channelCopies.begin(), channelCopies.end(), 0);
+    std::stable_sort(channelCopies.begin(), channelCopies.end(), [&copies](size_t nLeft, size_t nRight) {
+      return copies[nLeft].first->Device.device_id < copies[nRight].first->Device.device_id;
+    });
+
+    for (const size_t nCopy : channelCopies)
+    {
+      const LineUpEntry& entry = *copies[nCopy].second;
+      Channel channel;
+
+      // The merged channel's ID, or the ID of the copy on the device with the
+      // lowest ID, does not depend on the device carrying it
+      std::string strKey = entry.GuideNumber + "|" + entry.GuideName;
+      if (nCopy != channelCopies.front())
+        strKey += kodi::tools::StringUtils::Format("|%08X", copies[nCopy].first->Device.device_id);
+      channel.UID = m_ChannelIds->GetId(strKey);
+      channel.GuideNumber = entry.GuideNumber;
+      channel.ChannelName = entry.GuideName;
+      channel.HD = entry.HD;
+      channel.Favorite = entry.Favorite;
+
+      channel.Sources.reserve(copies.size());
+      channel.Sources.push_back(ChannelSource{copies[nCopy].first->Device.device_id, entry.URL});
+      for (size_t nOther = 0; nOther < copies.size(); nOther++)
+      {
+        if (nOther == nCopy)
+          continue;
+
+        channel.Sources.push_back(ChannelSource{copies[nOther].first->Device.device_id, copies[nOther].second->URL});
+        if (bMerge && copies[nOther].second->Favorite)
+          channel.Favorite = true;
+      }
+
+      // Guide data comes from the first device in source order that has it
+      for (size_t nOther = 0; nOther < copies.size() && !channel.pGuideChannel; nOther++)
+      {
+        const Tuner* pTuner = copies[(nCopy + nOther) % copies.size()].first;
+        const GuideChannel* pGuideChannel = pTuner->Guide ? pTuner->Guide->FindChannel(strGuideNumber) : nullptr;
+        if (!pGuideChannel)
+          continue;
+
+        channel.Guide = pTuner->Guide;
+        channel.pGuideChannel = pGuideChannel;
+        if (!pGuideChannel->Affiliate.empty())
+          channel.ChannelName = std::string(pGuideChannel->Affiliate);
+        channel.IconPath = std::string(pGuideChannel->ImageURL);
+      }
+
+      int nChannel = 0, nSubChannel = 0;
+      if (sscanf(strGuideNumber.c_str(), "%d.%d", &nChannel, &nSubChannel) != 2)
+      {
+        nSubChannel = 0;
+        if (sscanf(strGuideNumber.c_str(), "%d", &nChannel) != 1)
+          nChannel = nChannelNumber;
+      }
+      channel.ChannelNumber = nChannel;
+      channel.SubChannelNumber = nSubChannel;
+      nChannelNumber++;
+
+      if (m_ChannelIndex.emplace(channel.UID, m_Channels.size()).second)
+        m_Channels.emplace_back(std::move(channel));
+    }
+  }
+
+  KODI_LOG(ADDON_LOG_DEBUG, "Merged lineups into %u channels", static_cast<unsigned int>(m_Channels.size()));
+}
+
+void HDHomeRunTuners::SaveChannelIds()
+{
+  std::string strJson;
+  unsigned int nGeneration;
+
+  {
+    AutoLock l(this);
+    if (!m_ChannelIds->TakeChanges(strJson, nGeneration))
+      return;
+  }
+
+  // Writing goes through the VFS, keep it out of m_Lock
+  m_ChannelIds->Write(strJson, nGeneration);
+}
 
+const HDHomeRunTuners::Channel* HDHomeRunTuners::FindChannel(unsigned int uid) const
+{
+  const auto iter = m_ChannelIndex.find(uid);
+  return iter != m_ChannelIndex.end() ? &m_Channels[iter->second] : nullptr;
+}
+
+bool HDHomeRunTuners::UpdateRecordEngines()
+{
+  struct hdhomerun_discover_device_t foundDevices[16] = {};
+  int nEngineCount = 0;
+
+  if (SettingsType::Get().GetHttpDiscovery())
+    nEngineCount = DiscoverDevicesViaHttp(HDHOMERUN_DEVICE_TYPE_STORAGE, foundDevices, 16);
+
+  if (nEngineCount <= 0)
+    nEngineCount = hdhomerun_discover_find_devices_custom_v2(
+        0, HDHOMERUN_DEVICE_TYPE_STORAGE, HDHOMERUN_DEVICE_ID_WILDCARD, foundDevices, 16);
+
+  if (nEngineCount < 0)
+    nEngineCount = 0;
+
+  KODI_LOG(ADDON_LOG_DEBUG, "Found %d HDHomeRun record engines", nEngineCount);
+
+  std::lock_guard<std::mutex> updateLock(m_UpdateLock);
+  const time_t now = time(nullptr);
+  bool bChanged = false;
+
+  // Engines that cannot be reached are treated as missing from this discovery
+  std::vector<std::pair<hdhomerun_discover_device_t, StorageDetails>> engines;
+  for (int nEngineIndex = 0; nEngineIndex < nEngineCount; nEngineIndex++)
+  {
+    StorageDetails details;
+    if (RecordEngine::FetchDetails(foundDevices[nEngineIndex], details))
+      engines.emplace_back(foundDevices[nEngineIndex], std::move(details));
+  }
+
+  std::vector<std::pair<RecordEngine*, const StorageDetails*>> updates;
+
+  {
+    AutoLock l(this);
+
+    // Like tuners, engines missing from discoveries for long enough are dropped
+    const size_t nEngines = m_RecordEngines.size();
+    m_RecordEngines.erase(std::remove_if(m_RecordEngines.begin(), m_RecordEngines.end(),
+                                         [now](const RecordEngine& engine) { return now - engine.GetLastSeen() > StaleDeviceTimeout; }),
+                          m_RecordEngines.end());
+
+    if (m_RecordEngines.size() != nEngines)
+      bChanged = true;
+
+    // Keep the index of engines seen before so only their changes are fetched.
+    // Engines are matched by StorageID so an address change does not duplicate
+    // them, the address is only used for engines that do not report one.
+    std::vector<size_t> matched;
+    for (const auto& engine : engines)
+    {
+      const hdhomerun_discover_device_t& device = engine.first;
+      const std::string& strStorageID = engine.second.StorageID;
+      auto iter = std::find_if(m_RecordEngines.begin(), m_RecordEngines.end(),
+                               [&device, &strStorageID](const RecordEngine& recordEngine) {
+                                 return strStorageID.empty() ? recordEngine.GetStorageID().empty() && recordEngine.GetDevice().ip_addr == device.ip_addr
+                                                             : recordEngine.GetStorageID() == strStorageID;
+                               });
+
+      if (iter != m_RecordEngines.end())
+      {
+        if (iter->GetDevice().ip_addr != device.ip_addr)
+          KODI_LOG(ADDON_LOG_INFO, "HDHomeRun record engine %s moved to a new address", strStorageID.c_str());
+        iter->SetDevice(device);
+      }
+      else
+      {
+        m_RecordEngines.emplace_back(device, strStorageID);
+        iter = m_RecordEngines.end() - 1;
+        bChanged = true;
+      }
+      matched.push_back(static_cast<size_t>(iter - m_RecordEngines.begin()));
+      iter->SetLastSeen(now);
+    }
+
+    // Engines missing from this discovery keep their recordings, but are not
+    // listed until they are seen again
+    for (auto& engine : m_RecordEngines)
+    {
+      const bool bStale = engine.GetLastSeen() != now;
+      if (engine.IsStale() != bStale)
+      {
+        engine.SetStale(bStale);
+        bChanged = true;
+      }
+    }
+
+    for (size_t nIndex = 0; nIndex < engines.size(); nIndex++)
+      updates.emplace_back(&m_RecordEngines[matched[nIndex]], &engines[nIndex].second);
+  }
+
+  // The engines fetch without holding m_Lock and only take it to apply their changes
+  for (const auto& update : updates)
+    if (update.first->Update(m_Lock, *update.second, m_running))
+      bChanged = true;
+
+  return bChanged;
+}
+
+PVR_ERROR HDHomeRunTuners::GetChannelsAmount(int& amount)
+{
   AutoLock l(this);
 
-  for (const auto& iterTuner : m_Tuners)
-    for (const auto& jsonChannel : iterTuner.LineUp)
-      if (!jsonChannel["_Hide"].asBool())
-        amount++;
+  amount = static_cast<int>(m_Channels.size());
 
   return PVR_ERROR_NO_ERROR;
 }
 
 PVR_ERROR HDHomeRunTuners::GetChannels(bool radio, kodi::addon::PVRChannelsResultSet& results)
 {
+  LatencyStats::Scope latency(m_GetChannelsStats);
+
   if (radio)
     return PVR_ERROR_NO_ERROR;
 
   AutoLock l(this);
 
-  for (const auto& iterTuner : m_Tuners)
-    for (const auto& jsonChannel : iterTuner.LineUp)
-    {
-      if (jsonChannel["_Hide"].asBool())
-        continue;
-
-      kodi::addon::PVRChannel pvrChannel;
+  for (const auto& channel : m_Channels)
+  {
+    kodi::addon::PVRChannel pvrChannel;
 
-      pvrChannel.SetUniqueId(jsonChannel["_UID"].asUInt());
-      pvrChannel.SetChannelNumber(jsonChannel["_ChannelNumber"].asUInt());
-      pvrChannel.SetSubChannelNumber(jsonChannel["_SubChannelNumber"].asUInt());
-      pvrChannel.SetChannelName(jsonChannel["_ChannelName"].asString());
-      pvrChannel.SetIconPath(jsonChannel["_IconPath"].asString());
+    pvrChannel.SetUniqueId(channel.UID);
+    pvrChannel.SetChannelNumber(channel.ChannelNumber);
+    pvrChannel.SetSubChannelNumber(channel.SubChannelNumber);
+    pvrChannel.SetChannelName(channel.ChannelName);
+    pvrChannel.SetIconPath(channel.IconPath);
 
-      results.Add(pvrChannel);
-    }
+    results.Add(pvrChannel);
+  }
 
   return PVR_ERROR_NO_ERROR;
 }
 
 PVR_ERROR HDHomeRunTuners::GetChannelStreamProperties(const kodi::addon::PVRChannel& channel, PVR_SOURCE source, std::vector<kodi::addon::PVRStreamProperty>& properties)
 {
+  // With timeshift enabled Kodi reads the stream through OpenLiveStream(),
+  // until the ring file is prepared the stream is played directly
+  if (SettingsType::Get().GetTimeshift() && m_bTimeshiftReady)
+    return PVR_ERROR_NOT_IMPLEMENTED;
+
   std::string strUrl = GetChannelStreamURL(channel);
   if (strUrl.empty())
     return PVR_ERROR_FAILED;
@@ -425,73 +921,122 @@ PVR_ERROR HDHomeRunTuners::GetChannelStreamProperties(const kodi::addon::PVRChan
   return PVR_ERROR_NO_ERROR;
 }
 
-PVR_ERROR HDHomeRunTuners::GetSignalStatus(int channelUid, kodi::addon::PVRSignalStatus& signalStatus)
+bool HDHomeRunTuners::OpenLiveStream(const kodi::addon::PVRChannel& channel)
 {
-  signalStatus.SetAdapterName("PVR HDHomeRun Adapter 1");
-  signalStatus.SetAdapterStatus("OK");
+  CloseLiveStream();
 
-  return PVR_ERROR_NO_ERROR;
+  if (!m_bTimeshiftReady)
+    return false;
+
+  std::string strUrl = GetChannelStreamURL(channel);
+  if (strUrl.empty())
+    return false;
+
+  std::unique_ptr<TimeshiftBuffer> timeshift = std::make_unique<TimeshiftBuffer>();
+  if (!timeshift->Open(strUrl, SettingsType::Get().GetTimeshiftPath(), SettingsType::Get().GetTimeshiftBufferSize()))
+    return false;
+
+  m_Timeshift = std::move(timeshift);
+  return true;
+}
+
+void HDHomeRunTuners::CloseLiveStream()
+{
+  m_Timeshift.reset();
+}
+
+int HDHomeRunTuners::ReadLiveStream(unsigned char* buffer, unsigned int size)
+{
+  return m_Timeshift ? m_Timeshift->Read(buffer, size) : -1;
+}
+
+int64_t HDHomeRunTuners::SeekLiveStream(int64_t position, int whence)
+{
+  return m_Timeshift ? m_Timeshift->Seek(position, whence) : -1;
+}
+
+int64_t HDHomeRunTuners::LengthLiveStream()
+{
+  return m_Timeshift ? m_Timeshift->GetLength() : -1;
+}
+
+bool HDHomeRunTuners::CanPauseStream()
+{
+  return m_Timeshift != nullptr;
+}
+
+bool HDHomeRunTuners::CanSeekStream()
+{
+  return m_Timeshift != nullptr;
 }
 
-namespace
+bool HDHomeRunTuners::IsRealTimeStream()
 {
+  // Only real time while playing at (or very near) the live edge
+  return !m_Timeshift || m_Timeshift->GetReadTime() + 10 >= m_Timeshift->GetEndTime();
+}
 
-std::string ParseAsW3CDateString(time_t time)
+PVR_ERROR HDHomeRunTuners::GetStreamTimes(kodi::addon::PVRStreamTimes& times)
 {
-  std::tm* tm = std::gmtime(&time);
-  char buffer[16];
-  std::strftime(buffer, 16, "%Y-%m-%d", tm);
+  if (!m_Timeshift)
+    return PVR_ERROR_NOT_IMPLEMENTED;
 
-  return buffer;
+  const time_t start = m_Timeshift->GetStartTime();
+
+  times.SetStartTime(start);
+  times.SetPTSStart(0);
+  times.SetPTSBegin(0);
+  times.SetPTSEnd(static_cast<int64_t>(m_Timeshift->GetEndTime() - start) * STREAM_TIME_BASE);
+
+  return PVR_ERROR_NO_ERROR;
 }
 
-} // unnamed namespace
+PVR_ERROR HDHomeRunTuners::GetSignalStatus(int channelUid, kodi::addon::PVRSignalStatus& signalStatus)
+{
+  signalStatus.SetAdapterName("PVR HDHomeRun Adapter 1");
+  signalStatus.SetAdapterStatus("OK");
+
+  return PVR_ERROR_NO_ERROR;
+}
 
 PVR_ERROR HDHomeRunTuners::GetEPGForChannel(int channelUid, time_t start, time_t end, kodi::addon::PVREPGTagsResultSet& results)
 {
+  LatencyStats::Scope latency(m_GetEPGForChannelStats);
+
   AutoLock l(this);
 
-  for (const auto& iterTuner : m_Tuners)
-  {
-    for (const auto& jsonChannel : iterTuner.LineUp)
-    {
-      if (jsonChannel["_UID"].asUInt() != channelUid)
-        continue;
+  const Channel* pChannel = FindChannel(static_cast<unsigned int>(channelUid));
+  if (!pChannel || !pChannel->pGuideChannel)
+    return PVR_ERROR_NO_ERROR;
 
-      for (const auto& iterGuide : iterTuner.Guide)
-      {
-        if (iterGuide["GuideNumber"].asString() == jsonChannel["GuideNumber"].asString())
-        {
-          for (const auto& jsonGuideItem : iterGuide["Guide"])
-          {
-            if (static_cast<time_t>(jsonGuideItem["EndTime"].asUInt()) <= start || end < static_cast<time_t>(jsonGuideItem["StartTime"].asUInt()))
-              continue;
+  const std::vector<GuideEntry>& entries = pChannel->pGuideChannel->Entries;
+  const bool bMarkNew = SettingsType::Get().GetMarkNew();
 
-            time_t firstAired = static_cast<time_t>(jsonGuideItem["OriginalAirdate"].asUInt());
-            std::string strFirstAired((firstAired > 0) ? ParseAsW3CDateString(firstAired) : "");
-
-            kodi::addon::PVREPGTag tag;
-
-            tag.SetEpisodePartNumber(EPG_TAG_INVALID_SERIES_EPISODE);
-            tag.SetUniqueBroadcastId(jsonGuideItem["_UID"].asUInt());
-            tag.SetTitle(jsonGuideItem["Title"].asString());
-            tag.SetUniqueChannelId(channelUid);
-            tag.SetStartTime(static_cast<time_t>(jsonGuideItem["StartTime"].asUInt()));
-            tag.SetEndTime(static_cast<time_t>(jsonGuideItem["EndTime"].asUInt()));
-            tag.SetFirstAired(strFirstAired);
-            tag.SetPlot(jsonGuideItem["Synopsis"].asString());
-            tag.SetIconPath(jsonGuideItem["ImageURL"].asString());
-            tag.SetSeriesNumber(jsonGuideItem["_SeriesNumber"].asInt());
-            tag.SetEpisodeNumber(jsonGuideItem["_EpisodeNumber"].asInt());
-            tag.SetGenreType(jsonGuideItem["_GenreType"].asUInt());
-            tag.SetEpisodeName(jsonGuideItem["EpisodeTitle"].asString());
-            tag.SetSeriesLink(jsonGuideItem["SeriesID"].asString());
-
-            results.Add(tag);
-          }
-        }
-      }
-    }
+  // Entries are sorted by start time and Seal() removed overlaps, so skip straight to the window
+  auto iterEntry = std::partition_point(entries.begin(), entries.end(),
+                                        [start](const GuideEntry& entry) { return entry.EndTime <= start; });
+
+  for (; iterEntry != entries.end() && iterEntry->StartTime <= end; ++iterEntry)
+  {
+    const GuideEntry& guideEntry = *iterEntry;
+    kodi::addon::PVREPGTag tag;
+
+    tag.SetEpisodePartNumber(EPG_TAG_INVALID_SERIES_EPISODE);
+    tag.SetUniqueBroadcastId(guideEntry.UID);
+    tag.SetTitle(bMarkNew && guideEntry.New ? "*" + std::string(guideEntry.Title) : std::string(guideEntry.Title));
+    tag.SetUniqueChannelId(channelUid);
+    tag.SetStartTime(guideEntry.StartTime);
+    tag.SetEndTime(guideEntry.EndTime);
+    tag.SetFirstAired(std::string(guideEntry.FirstAired));
+    tag.SetPlot(std::string(guideEntry.Synopsis));
+    tag.SetIconPath(std::string(guideEntry.ImageURL));
+    tag.SetSeriesNumber(guideEntry.SeriesNumber);
+    tag.SetEpisodeNumber(guideEntry.EpisodeNumber);
+    tag.SetGenreType(guideEntry.GenreType);
+    tag.SetEpisodeName(std::string(guideEntry.EpisodeTitle));
+    tag.SetSeriesLink(std::string(guideEntry.SeriesID));
+
+    results.Add(tag);
   }
 
   return PVR_ERROR_NO_ERROR;
@@ -527,85 +1072,219 @@ PVR_ERROR HDHomeRunTuners::GetChannelGroups(bool radio, kodi::addon::PVRChannelG
 
 PVR_ERROR HDHomeRunTuners::GetChannelGroupMembers(const kodi::addon::PVRChannelGroup& group, kodi::addon::PVRChannelGroupMembersResultSet& results)
 {
+  LatencyStats::Scope latency(m_GetChannelGroupMembersStats);
+
   AutoLock l(this);
 
-  for (const auto& iterTuner : m_Tuners)
-    for (const auto& jsonChannel : iterTuner.LineUp)
+  for (const auto& channel : m_Channels)
+  {
+    if ((g_strGroupFavoriteChannels == group.GetGroupName() && !channel.Favorite) ||
+        (g_strGroupHDChannels == group.GetGroupName() && !channel.HD) ||
+        (g_strGroupSDChannels == group.GetGroupName() && channel.HD))
+      continue;
+
+    kodi::addon::PVRChannelGroupMember channelGroupMember;
+
+    channelGroupMember.SetGroupName(group.GetGroupName());
+    channelGroupMember.SetChannelUniqueId(channel.UID);
+    channelGroupMember.SetChannelNumber(channel.ChannelNumber);
+    channelGroupMember.SetSubChannelNumber(channel.SubChannelNumber);
+
+    results.Add(channelGroupMember);
+  }
+
+  return PVR_ERROR_NO_ERROR;
+}
+
+PVR_ERROR HDHomeRunTuners::GetRecordingsAmount(bool deleted, int& amount)
+{
+  amount = 0;
+
+  if (deleted)
+    return PVR_ERROR_NO_ERROR;
+
+  AutoLock l(this);
+
+  for (const auto& engine : m_RecordEngines)
+    if (!engine.IsStale())
+      amount += static_cast<int>(engine.GetRecordingCount());
+
+  return PVR_ERROR_NO_ERROR;
+}
+
+PVR_ERROR HDHomeRunTuners::GetRecordings(bool deleted, kodi::addon::PVRRecordingsResultSet& results)
+{
+  if (deleted)
+    return PVR_ERROR_NO_ERROR;
+
+  AutoLock l(this);
+
+  for (const auto& engine : m_RecordEngines)
+  {
+    if (engine.IsStale())
+      continue;
+
+    engine.ForEachRecording([&results](const Recording& recording)
     {
-      if (jsonChannel["_Hide"].asBool() ||
-          (g_strGroupFavoriteChannels == group.GetGroupName() && !jsonChannel["Favorite"].asBool()) ||
-          (g_strGroupHDChannels == group.GetGroupName() && !jsonChannel["HD"].asBool()) ||
-          (g_strGroupSDChannels == group.GetGroupName() && jsonChannel["HD"].asBool()))
-        continue;
+      kodi::addon::PVRRecording pvrRecording;
+
+      pvrRecording.SetRecordingId(recording.RecordingId);
+      pvrRecording.SetTitle(recording.Title);
+      pvrRecording.SetEpisodeName(recording.EpisodeTitle);
+      pvrRecording.SetPlot(recording.Synopsis);
+      pvrRecording.SetChannelName(recording.ChannelName);
+      pvrRecording.SetIconPath(recording.ImageURL);
+      pvrRecording.SetThumbnailPath(recording.ImageURL);
+      pvrRecording.SetRecordingTime(recording.RecordStartTime);
+      pvrRecording.SetDuration(static_cast<int>(recording.RecordEndTime - recording.RecordStartTime));
+      pvrRecording.SetSeriesNumber(recording.SeriesNumber);
+      pvrRecording.SetEpisodeNumber(recording.EpisodeNumber);
+      pvrRecording.SetFirstAired(recording.FirstAired);
+      pvrRecording.SetGenreType(recording.GenreType);
+      pvrRecording.SetSeriesLink(recording.SeriesID);
+      pvrRecording.SetChannelType(PVR_RECORDING_CHANNEL_TYPE_TV);
+
+      results.Add(pvrRecording);
+    });
+  }
+
+  return PVR_ERROR_NO_ERROR;
+}
 
-      kodi::addon::PVRChannelGroupMember channelGroupMember;
+PVR_ERROR HDHomeRunTuners::GetRecordingStreamProperties(const kodi::addon::PVRRecording& recording, std::vector<kodi::addon::PVRStreamProperty>& properties)
+{
+  std::string strUrl;
+
+  {
+    AutoLock l(this);
 
-      channelGroupMember.SetGroupName(group.GetGroupName());
-      channelGroupMember.SetChannelUniqueId(jsonChannel["_UID"].asUInt());
-      channelGroupMember.SetChannelNumber(jsonChannel["_ChannelNumber"].asUInt());
-      channelGroupMember.SetSubChannelNumber(jsonChannel["_SubChannelNumber"].asUInt());
+    for (const auto& engine : m_RecordEngines)
+    {
+      if (engine.IsStale())
+        continue;
 
-      results.Add(channelGroupMember);
+      const Recording* pRecording = engine.FindRecording(recording.GetRecordingId());
+      if (pRecording)
+      {
+        strUrl = engine.GetPlayURL(*pRecording);
+        break;
+      }
     }
+  }
+
+  if (strUrl.empty())
+    return PVR_ERROR_FAILED;
+
+  properties.emplace_back(PVR_STREAM_PROPERTY_STREAMURL, strUrl);
+  properties.emplace_back(PVR_STREAM_PROPERTY_ISREALTIMESTREAM, "false");
 
   return PVR_ERROR_NO_ERROR;
 }
 
-// Function to return stream url from any available device.
+// Function to return stream url from the first device able to serve the channel.
 // Potential issue: Still possible race condition between test and player start. Without
 //        using libhdhomerun and actively managing tuner locks and using *livestream functions
 //        this race condition cannot be worked around as i see it.
 // ToDo: Potentially implement preferred tuner. At the moment as long as the tuner can
-//       show the channel requested, it will test in an unknown* order
-//       *unknown = device discovery order, which is not guaranteed to be the same from
-//                  startup to startup
+//       show the channel requested, it will test in device discovery order, which is not
+//       guaranteed to be the same from startup to startup
 std::string HDHomeRunTuners::GetChannelStreamURL(const kodi::addon::PVRChannel& channel)
 {
-  AutoLock l(this);
+  LatencyStats::Scope latency(m_GetChannelStreamURLStats);
+
+  std::vector<ChannelSource> sources;
+  std::vector<std::vector<std::string>> profiles;
+  std::vector<Throughput> throughputs;
 
-  for (const auto& iterTuner : m_Tuners)
   {
-    for (const auto& jsonChannel : iterTuner.LineUp)
+    AutoLock l(this);
+
+    const Channel* pChannel = FindChannel(channel.GetUniqueId());
+    if (pChannel)
     {
-      if (jsonChannel["_UID"].asUInt() == channel.GetUniqueId() ||
-           (channel.GetChannelNumber() == jsonChannel["_ChannelNumber"].asUInt() &&
-            channel.GetSubChannelNumber() == jsonChannel["_SubChannelNumber"].asUInt() &&
-            channel.GetChannelName() == jsonChannel["_ChannelName"].asString()))
+      sources = pChannel->Sources;
+
+      for (const auto& source : sources)
       {
-        kodi::vfs::CFile fileHandle;
+        const auto iterTuner = std::find_if(m_Tuners.begin(), m_Tuners.end(),
+                                            [&source](const Tuner& tuner) { return tuner.Device.device_id == source.DeviceID; });
+        profiles.push_back(iterTuner != m_Tuners.end() ? iterTuner->TranscodeProfiles : std::vector<std::string>());
 
-        if (fileHandle.CURLCreate(jsonChannel["URL"].asString()))
-        {
-          fileHandle.CURLAddOption(ADDON_CURL_OPTION_PROTOCOL , "failonerror", "false");
-          int returnCode = -1;
+        const auto iterThroughput = m_Throughput.find(source.DeviceID);
+        throughputs.push_back(iterThroughput != m_Throughput.end() ? iterThroughput->second : Throughput());
+      }
+    }
+  }
 
-          if (fileHandle.CURLOpen(ADDON_READ_NO_CACHE))
-          {
-            std::string proto = fileHandle.GetPropertyValue(ADDON_FILE_PROPERTY_RESPONSE_PROTOCOL, "");
-            std::string::size_type posResponseCode = proto.find(' ');
-            if (posResponseCode != std::string::npos)
-              returnCode = atoi(proto.c_str() + (posResponseCode + 1));
-          }
-          fileHandle.Close();
+  const bool bAutoTranscode = SettingsType::Get().GetTranscode() == 1;
+  const time_t now = time(nullptr);
 
-          if (returnCode <= 400)
-          {
-            return jsonChannel["URL"].asString();
-          }
-          else if (returnCode == 403)
-          {
-            KODI_LOG(ADDON_LOG_DEBUG, "Tuner ID: %d URL Unavailable: %s, Error Code: %d, All tuners in use on device",
-                        channel.GetUniqueId(), jsonChannel["URL"].asString().c_str(), returnCode);
-          }
-          else
-          {
-            // ToDo: Not an oversubscription error, implement a count against specific tuners. If > x non 403 failures, blacklist tuner??
-            //       potentially flag date/time of last failure, move tuner to blacklist, retry blacklist device y hours after last failure (24?)
-            KODI_LOG(ADDON_LOG_DEBUG, "Tuner ID: %d URL Unavailable: %s, Error Code: %d",
-                        channel.GetUniqueId(), jsonChannel["URL"].asString().c_str(), returnCode);
-          }
-        }
+  // Probe outside the lock, the requests can take a while
+  for (size_t nSource = 0; nSource < sources.size(); nSource++)
+  {
+    const ChannelSource& source = sources[nSource];
+    Throughput& throughput = throughputs[nSource];
+
+    // The untranscoded stream is sampled while probing when the estimate is outdated
+    const bool bSample = bAutoTranscode && !profiles[nSource].empty() &&
+                         now - throughput.Measured > ThroughputSampleInterval;
+    StreamRate rate;
+    int returnCode = -1;
+
+    if (!ProbeStream(source.URL, returnCode, bSample ? &rate : nullptr))
+      continue;
+
+    // An unreachable device has no response code, fail over to the next source
+    if (returnCode >= 200 && returnCode < 400)
+    {
+      // The stream is sent at its own bitrate, so only a stream falling behind
+      // its clock says something about the link; its delivered rate is then
+      // what the link manages
+      const double dStreamSeconds = rate.GetStreamSeconds();
+      const double dWallSeconds = rate.GetWallSeconds();
+      if (dStreamSeconds > 0 && dWallSeconds > 0)
+      {
+        const double dMbps = rate.GetDeliveredMbps();
+        const bool bLimited = dStreamSeconds < dWallSeconds * ThroughputKeepUpRatio;
+
+        throughput.Mbps = bLimited && throughput.Limited ? (throughput.Mbps + dMbps) / 2 : dMbps;
+        throughput.Limited = bLimited;
+        throughput.Measured = now;
+
+        KODI_LOG(ADDON_LOG_DEBUG, "Tuner ID: %08X %.2f s of stream in %.2f s at %.1f Mbit/s, %s", source.DeviceID,
+                 dStreamSeconds, dWallSeconds, dMbps, bLimited ? "falling behind" : "keeping up");
+
+        AutoLock l(this);
+        m_Throughput[source.DeviceID] = throughput;
+      }
+
+      const std::string strProfile = SelectTranscodeProfile(profiles[nSource], throughput);
+      if (!strProfile.empty())
+      {
+        const std::string strTranscodeUrl = source.URL + (source.URL.find('?') == std::string::npos ? "?" : "&") +
+                                            "transcode=" + strProfile;
+
+        // The device only has a few transcoders, fall back to the untranscoded stream
+        if (ProbeStream(strTranscodeUrl, returnCode, nullptr) && returnCode >= 200 && returnCode < 400)
+          return strTranscodeUrl;
+
+        KODI_LOG(ADDON_LOG_DEBUG, "Tuner ID: %08X URL Unavailable: %s, Error Code: %d, Using untranscoded stream",
+                    source.DeviceID, strTranscodeUrl.c_str(), returnCode);
       }
+
+      return source.URL;
+    }
+    else if (returnCode == 403)
+    {
+      KODI_LOG(ADDON_LOG_DEBUG, "Tuner ID: %08X URL Unavailable: %s, Error Code: %d, All tuners in use on device",
+                  source.DeviceID, source.URL.c_str(), returnCode);
+    }
+    else
+    {
+      // ToDo: Not an oversubscription error, implement a count against specific tuners. If > x non 403 failures, blacklist tuner??
+      //       potentially flag date/time of last failure, move tuner to blacklist, retry blacklist device y hours after last failure (24?)
+      KODI_LOG(ADDON_LOG_DEBUG, "Tuner ID: %08X URL Unavailable: %s, Error Code: %d",
+                  source.DeviceID, source.URL.c_str(), returnCode);
     }
   }
 
@@ -613,4 +1292,38 @@ std::string HDHomeRunTuners::GetChannelStreamURL(const kodi::addon::PVRChannel&
   return "";
 }
 
+// Picks the profile for a device's stream from the transcode setting, empty
+// if the stream is to be played as broadcast
+std::string HDHomeRunTuners::SelectTranscodeProfile(const std::vector<std::string>& profiles,
+                                                    const Throughput& throughput) const
+{
+  const SettingsType& settings = SettingsType::Get();
+  const int nTranscode = settings.GetTranscode();
+  std::string strProfile;
+
+  if (nTranscode <= 0 || profiles.empty())
+    return strProfile;
+
+  if (nTranscode == 1)
+  {
+    // A link that keeps up with the broadcast needs no transcoding
+    if (!throughput.Limited)
+      return strProfile;
+
+    if (throughput.Mbps < settings.GetTranscodeInternetBelow())
+      strProfile = "internet480";
+    else if (throughput.Mbps < settings.GetTranscodeMobileBelow())
+      strProfile = "mobile";
+    else if (throughput.Mbps < settings.GetTranscodeHeavyBelow())
+      strProfile = "heavy";
+  }
+  else if (static_cast<size_t>(nTranscode - 2) < std::size(g_TranscodeProfiles))
+    strProfile = g_TranscodeProfiles[nTranscode - 2];
+
+  if (!strProfile.empty() && std::find(profiles.begin(), profiles.end(), strProfile) == profiles.end())
+    strProfile.clear();
+
+  return strProfile;
+}
+
 ADDONCREATOR(HDHomeRunTuners)
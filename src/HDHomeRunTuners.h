@@ -9,10 +9,19 @@
 
 #pragma once
 
+#include "GuideData.h"
+#include "IdRegistry.h"
+#include "LatencyStats.h"
+#include "RecordEngine.h"
+#include "TimeshiftBuffer.h"
+
 #include <atomic>
+#include <condition_variable>
+#include <ctime>
 #include <mutex>
 #include <string>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include "hdhomerun.h"
@@ -31,6 +40,34 @@ public:
     UpdateGuide = 4
   };
 
+  // Record engines are synced more often than the lineups and guide
+  static constexpr int RecordingsUpdateInterval = 5 * 60;
+  static constexpr int UpdatePassesPerGuideUpdate = 12;
+
+  // Devices missing from discovery keep their channels and guide this long
+  static constexpr time_t StaleDeviceTimeout = 24 * 60 * 60;
+  // Longest delay between rediscovery attempts after a wake
+  static constexpr int MaxWakeRetryDelay = 64;
+
+  // In automatic transcode mode the start of the untranscoded stream is read
+  // at most this often per device, for this long or this much at most, and
+  // the stream falls behind if its clock advances slower than this share
+  // of the wall clock
+  static constexpr time_t ThroughputSampleInterval = 10 * 60;
+  static constexpr int ThroughputSampleTimeMs = 1000;
+  static constexpr size_t ThroughputSampleSize = 8 * 1024 * 1024;
+  static constexpr double ThroughputKeepUpRatio = 0.9;
+
+  struct LineUpEntry
+  {
+    std::string GuideNumber;
+    std::string GuideName;
+    std::string URL;
+    bool DRM = false;
+    bool HD = false;
+    bool Favorite = false;
+  };
+
   struct Tuner
   {
     Tuner()
@@ -39,8 +76,51 @@ public:
     }
 
     hdhomerun_discover_device_t Device;
-    Json::Value LineUp;
-    Json::Value Guide;
+    bool Stale = false;
+    time_t LastSeen = 0;
+    std::vector<LineUpEntry> LineUp;
+    std::shared_ptr<const GuideData> Guide;
+
+    // Profiles from the device's transcode feature, empty if it cannot transcode
+    bool FeaturesKnown = false;
+    std::vector<std::string> TranscodeProfiles;
+  };
+
+  // What the last samples showed about the link between this client and a
+  // device. Mbps is the link's rate while the stream falls behind (averaged
+  // over such samples), otherwise just the bitrate of the stream it kept up with.
+  struct Throughput
+  {
+    double Mbps = 0;
+    bool Limited = false;
+    time_t Measured = 0;
+  };
+
+  // One device's copy of a channel
+  struct ChannelSource
+  {
+    uint32_t DeviceID;
+    std::string URL;
+  };
+
+  // A channel as presented to Kodi, merged across every device carrying it
+  struct Channel
+  {
+    unsigned int UID = 0;
+    std::string GuideNumber;
+    std::string ChannelName;
+    std::string IconPath;
+    unsigned int ChannelNumber = 0;
+    unsigned int SubChannelNumber = 0;
+    bool HD = false;
+    bool Favorite = false;
+
+    // In order of preference, later sources are the failover candidates
+    std::vector<ChannelSource> Sources;
+
+    // Guide slice, resolved when the lineup or guide changes
+    std::shared_ptr<const GuideData> Guide;
+    const GuideChannel* pGuideChannel = nullptr;
   };
 
   class AutoLock
@@ -71,6 +151,7 @@ public:
   PVR_ERROR OnSystemWake() override;
 
   bool Update(int nMode = UpdateDiscover | UpdateLineUp | UpdateGuide);
+  bool UpdateRecordEngines();
   PVR_ERROR GetChannels(bool radio, kodi::addon::PVRChannelsResultSet& results) override;
   PVR_ERROR GetChannelsAmount(int& amount) override;
   PVR_ERROR GetChannelStreamProperties(const kodi::addon::PVRChannel& channel, PVR_SOURCE source, std::vector<kodi::addon::PVRStreamProperty>& properties) override;
@@ -79,19 +160,55 @@ public:
   PVR_ERROR GetChannelGroupsAmount(int& amount) override;
   PVR_ERROR GetChannelGroups(bool radio, kodi::addon::PVRChannelGroupsResultSet& results) override;
   PVR_ERROR GetChannelGroupMembers(const kodi::addon::PVRChannelGroup& group, kodi::addon::PVRChannelGroupMembersResultSet& results) override;
+  bool OpenLiveStream(const kodi::addon::PVRChannel& channel) override;
+  void CloseLiveStream() override;
+  int ReadLiveStream(unsigned char* buffer, unsigned int size) override;
+  int64_t SeekLiveStream(int64_t position, int whence) override;
+  int64_t LengthLiveStream() override;
+  bool CanPauseStream() override;
+  bool CanSeekStream() override;
+  bool IsRealTimeStream() override;
+  PVR_ERROR GetStreamTimes(kodi::addon::PVRStreamTimes& times) override;
+  PVR_ERROR GetRecordingsAmount(bool deleted, int& amount) override;
+  PVR_ERROR GetRecordings(bool deleted, kodi::addon::PVRRecordingsResultSet& results) override;
+  PVR_ERROR GetRecordingStreamProperties(const kodi::addon::PVRRecording& recording, std::vector<kodi::addon::PVRStreamProperty>& properties) override;
 
 protected:
   void Process();
+  void RediscoverAfterWake();
+  void LogStats();
 
 private:
   std::string GetChannelStreamURL(const kodi::addon::PVRChannel& channel);
+  std::string SelectTranscodeProfile(const std::vector<std::string>& profiles, const Throughput& throughput) const;
 
-  unsigned int PvrCalculateUniqueId(const std::string& str);
+  int DiscoverDevicesViaHttp(uint32_t devicetype, struct hdhomerun_discover_device_t* devices, int maxdevices);
 
-  int DiscoverTunersViaHttp(struct hdhomerun_discover_device_t* tuners, int maxtuners);
+  void UpdateChannels();
+  // Must be called without m_Lock, after UpdateChannels() added channel IDs
+  void SaveChannelIds();
+  const Channel* FindChannel(unsigned int uid) const;
 
   std::vector<Tuner> m_Tuners;
+  std::vector<Channel> m_Channels;
+  std::unordered_map<unsigned int, size_t> m_ChannelIndex;
+  std::unique_ptr<IdRegistry> m_ChannelIds;
+  std::unordered_map<uint32_t, Throughput> m_Throughput;
+  std::vector<RecordEngine> m_RecordEngines;
+  std::unique_ptr<TimeshiftBuffer> m_Timeshift;
   std::atomic<bool> m_running = {false};
+  std::atomic<bool> m_bWakePending = {false};
+  std::atomic<bool> m_bRediscoverPending = {false};
+  // Set once the ring file is prepared, streams play without timeshift until then
+  std::atomic<bool> m_bTimeshiftReady = {false};
   std::thread m_thread;
-  std::mutex m_Lock;
+  std::mutex m_ProcessLock;
+  std::condition_variable m_ProcessCondition;
+  InstrumentedMutex m_Lock{"Lock wait"};
+  std::mutex m_UpdateLock;
+
+  LatencyStats m_GetChannelsStats{"GetChannels"};
+  LatencyStats m_GetEPGForChannelStats{"GetEPGForChannel"};
+  LatencyStats m_GetChannelGroupMembersStats{"GetChannelGroupMembers"};
+  LatencyStats m_GetChannelStreamURLStats{"GetChannelStreamURL"};
 };
@@ -0,0 +1,136 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2015 Zoltan Csizmadia (zcsizmadia@gmail.com)
+ *  Copyright (C) 2011 Pulse-Eight (https://www.pulse-eight.com)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "IdRegistry.h"
+#include "Utils.h"
+
+#include <json/json.h>
+#include <kodi/Filesystem.h>
+
+void IdRegistry::Load()
+{
+  m_bLoaded = true;
+  m_bDirty = false;
+  m_Ids.clear();
+  m_Keys.clear();
+
+  kodi::vfs::CFile fileHandle;
+  if (!kodi::vfs::FileExists(m_strFile) || !fileHandle.OpenFile(m_strFile))
+    return;
+
+  std::string strJson, jsonReaderError;
+  char buffer[4096];
+  ssize_t bytesRead;
+  while ((bytesRead = fileHandle.Read(buffer, sizeof(buffer))) > 0)
+    strJson.append(buffer, bytesRead);
+
+  Json::CharReaderBuilder jsonReaderBuilder;
+  std::unique_ptr<Json::CharReader> const jsonReader(jsonReaderBuilder.newCharReader());
+  Json::Value jsonIds;
+
+  if (!jsonReader->parse(strJson.c_str(), strJson.c_str() + strJson.size(), &jsonIds, &jsonReaderError) ||
+      jsonIds.type() != Json::objectValue)
+  {
+    KODI_LOG(ADDON_LOG_ERROR, "Failed to parse ID registry %s", m_strFile.c_str());
+    return;
+  }
+
+  for (const auto& strKey : jsonIds.getMemberNames())
+  {
+    const unsigned int nId = jsonIds[strKey].asUInt();
+    if (nId != 0 && m_Keys.emplace(nId, strKey).second)
+      m_Ids.emplace(strKey, nId);
+  }
+
+  KODI_LOG(ADDON_LOG_DEBUG, "Loaded %u IDs from %s", static_cast<unsigned int>(m_Ids.size()), m_strFile.c_str());
+}
+
+bool IdRegistry::TakeChanges(std::string& strJson, unsigned int& nGeneration)
+{
+  if (!m_bDirty)
+    return false;
+
+  Json::Value jsonIds(Json::objectValue);
+  for (const auto& iter : m_Ids)
+    jsonIds[iter.first] = iter.second;
+
+  Json::StreamWriterBuilder jsonWriterBuilder;
+  strJson = Json::writeString(jsonWriterBuilder, jsonIds);
+  nGeneration = ++m_nGeneration;
+  m_bDirty = false;
+
+  return true;
+}
+
+void IdRegistry::Write(const std::string& strJson, unsigned int nGeneration)
+{
+  std::lock_guard<std::mutex> lock(m_WriteLock);
+
+  // IDs are only ever added, so a newer copy already holds this one's
+  if (nGeneration <= m_nWrittenGeneration)
+    return;
+
+  const std::string strTempFile = m_strFile + ".tmp";
+
+  {
+    kodi::vfs::CFile fileHandle;
+    if (!fileHandle.OpenFileForWrite(strTempFile, true) ||
+        fileHandle.Write(strJson.c_str(), strJson.size()) != static_cast<ssize_t>(strJson.size()))
+    {
+      KODI_LOG(ADDON_LOG_ERROR, "Failed to write ID registry %s", strTempFile.c_str());
+      return;
+    }
+    fileHandle.Flush();
+  }
+
+  if (!kodi::vfs::RenameFile(strTempFile, m_strFile))
+  {
+    KODI_LOG(ADDON_LOG_ERROR, "Failed to replace ID registry %s", m_strFile.c_str());
+    return;
+  }
+
+  m_nWrittenGeneration = nGeneration;
+}
+
+unsigned int IdRegistry::GetId(const std::string& strKey)
+{
+  if (!m_bLoaded)
+    Load();
+
+  const auto iter = m_Ids.find(strKey);
+  if (iter != m_Ids.end())
+    return iter->second;
+
+  unsigned int nId = Hash(strKey);
+  while (m_Keys.find(nId) != m_Keys.end())
+  {
+    KODI_LOG(ADDON_LOG_DEBUG, "ID %u of %s collides with %s", nId, strKey.c_str(), m_Keys[nId].c_str());
+    nId = nId >= 0x7FFFFFFF ? 1 : nId + 1;
+  }
+
+  m_Ids.emplace(strKey, nId);
+  m_Keys.emplace(nId, strKey);
+  m_bDirty = true;
+
+  return nId;
+}
+
+unsigned int IdRegistry::Hash(const std::string& str)
+{
+  // 32-bit FNV-1a, kept positive and non-zero as Kodi stores the IDs as int
+  uint32_t nHash = 2166136261u;
+  for (const auto& c : str)
+  {
+    nHash ^= static_cast<unsigned char>(c);
+    nHash *= 16777619u;
+  }
+
+  nHash &= 0x7FFFFFFF;
+  return nHash != 0 ? nHash : 1;
+}
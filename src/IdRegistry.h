@@ -0,0 +1,50 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2015 Zoltan Csizmadia (zcsizmadia@gmail.com)
+ *  Copyright (C) 2011 Pulse-Eight (https://www.pulse-eight.com)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <kodi/AddonBase.h>
+
+// Persistent mapping of keys to unique IDs. A new key gets the FNV-1a hash
+// of the key (which is the same on every platform) or, if that ID is
+// already taken, the next free one; once assigned an ID never changes.
+class ATTR_DLL_LOCAL IdRegistry
+{
+public:
+  explicit IdRegistry(const std::string& strFile) : m_strFile(strFile) {}
+
+  void Load();
+
+  // Copies the registry if IDs were added since the last Load() or
+  // TakeChanges(), so the caller can Write() it once its lock is released
+  bool TakeChanges(std::string& strJson, unsigned int& nGeneration);
+  // Replaces the file through a temporary one, so a crash never leaves it
+  // truncated; a copy older than the one last written is dropped
+  void Write(const std::string& strJson, unsigned int nGeneration);
+
+  unsigned int GetId(const std::string& strKey);
+
+  static unsigned int Hash(const std::string& str);
+
+private:
+  std::string m_strFile;
+  bool m_bLoaded = false;
+  bool m_bDirty = false;
+  unsigned int m_nGeneration = 0;
+  std::unordered_map<std::string, unsigned int> m_Ids;
+  std::unordered_map<unsigned int, std::string> m_Keys;
+
+  // Writes happen outside the caller's lock, possibly from two threads
+  std::mutex m_WriteLock;
+  unsigned int m_nWrittenGeneration = 0;
+};
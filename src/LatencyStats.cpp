@@ -0,0 +1,86 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2015 Zoltan Csizmadia (zcsizmadia@gmail.com)
+ *  Copyright (C) 2011 Pulse-Eight (https://www.pulse-eight.com)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "LatencyStats.h"
+#include "Utils.h"
+
+#include <algorithm>
+
+void LatencyStats::Add(std::chrono::steady_clock::duration duration)
+{
+  const uint32_t nMicroseconds = static_cast<uint32_t>(std::min<int64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(duration).count(), UINT32_MAX));
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  m_Samples[m_nCount % SampleCount] = nMicroseconds;
+  m_nCount++;
+  m_nMax = std::max(m_nMax, nMicroseconds);
+}
+
+void LatencyStats::Log()
+{
+  std::array<uint32_t, SampleCount> samples;
+  uint64_t nCount;
+  uint32_t nMax;
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    samples = m_Samples;
+    nCount = m_nCount;
+    nMax = m_nMax;
+    m_nCount = 0;
+    m_nMax = 0;
+  }
+
+  if (nCount == 0)
+    return;
+
+  const size_t nSamples = static_cast<size_t>(std::min<uint64_t>(nCount, SampleCount));
+  auto percentile = [&samples, nSamples](size_t nPercent)
+  {
+    const size_t nIndex = std::min(nSamples - 1, nSamples * nPercent / 100);
+    std::nth_element(samples.begin(), samples.begin() + nIndex, samples.begin() + nSamples);
+    return samples[nIndex];
+  };
+
+  const uint32_t nP50 = percentile(50);
+  const uint32_t nP99 = percentile(99);
+
+  KODI_LOG(ADDON_LOG_DEBUG, "%s: %llu calls, p50 %u us, p99 %u us, max %u us", m_szName,
+           static_cast<unsigned long long>(nCount), nP50, nP99, nMax);
+}
+
+void InstrumentedMutex::lock()
+{
+  m_nLockCount++;
+
+  if (m_mutex.try_lock())
+    return;
+
+  LatencyStats::Scope wait(m_WaitStats);
+  m_mutex.lock();
+}
+
+bool InstrumentedMutex::try_lock()
+{
+  if (!m_mutex.try_lock())
+    return false;
+
+  m_nLockCount++;
+  return true;
+}
+
+void InstrumentedMutex::LogStats()
+{
+  KODI_LOG(ADDON_LOG_DEBUG, "Lock: %u acquisitions", m_nLockCount.exchange(0));
+
+  m_WaitStats.Log();
+}
@@ -0,0 +1,72 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2015 Zoltan Csizmadia (zcsizmadia@gmail.com)
+ *  Copyright (C) 2011 Pulse-Eight (https://www.pulse-eight.com)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+#include <kodi/AddonBase.h>
+
+// Collects call durations for one operation and reports percentiles of the
+// samples gathered since the previous report to the debug log
+class ATTR_DLL_LOCAL LatencyStats
+{
+public:
+  explicit LatencyStats(const char* szName) : m_szName(szName) {}
+
+  void Add(std::chrono::steady_clock::duration duration);
+
+  // Logs count, p50, p99 and max since the last call and starts a new window
+  void Log();
+
+  class Scope
+  {
+  public:
+    explicit Scope(LatencyStats& stats) : m_stats(stats), m_start(std::chrono::steady_clock::now()) {}
+    ~Scope() { m_stats.Add(std::chrono::steady_clock::now() - m_start); }
+
+  private:
+    LatencyStats& m_stats;
+    std::chrono::steady_clock::time_point m_start;
+  };
+
+private:
+  // Percentiles are taken over the most recent samples of the window
+  static constexpr size_t SampleCount = 1024;
+
+  const char* m_szName;
+  std::mutex m_mutex;
+  std::array<uint32_t, SampleCount> m_Samples = {};
+  uint64_t m_nCount = 0;
+  uint32_t m_nMax = 0;
+};
+
+// Mutex counting its acquisitions and recording how long lock() waited
+// whenever it was contended
+class ATTR_DLL_LOCAL InstrumentedMutex
+{
+public:
+  explicit InstrumentedMutex(const char* szName) : m_WaitStats(szName) {}
+
+  void lock();
+  bool try_lock();
+  void unlock() { m_mutex.unlock(); }
+
+  // Logs the acquisitions and wait times since the last call
+  void LogStats();
+
+private:
+  std::mutex m_mutex;
+  std::atomic<unsigned int> m_nLockCount = {0};
+  LatencyStats m_WaitStats;
+};
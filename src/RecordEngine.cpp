@@ -0,0 +1,309 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2015 Zoltan Csizmadia (zcsizmadia@gmail.com)
+ *  Copyright (C) 2011 Pulse-Eight (https://www.pulse-eight.com)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "RecordEngine.h"
+#include "Utils.h"
+
+#include <kodi/addon-instance/PVR.h>
+#include <kodi/tools/StringUtils.h>
+#include <cstring>
+#include <set>
+#include <tuple>
+
+namespace
+{
+
+// Series entries do not change when an older episode is deleted, so the
+// whole index is re-fetched from time to time to pick up such removals
+constexpr time_t FullSyncInterval = 60 * 60;
+
+unsigned int GetGenreType(const std::string& strCategory)
+{
+  if (strCategory == "movie")
+    return EPG_EVENT_CONTENTMASK_MOVIEDRAMA;
+  else if (strCategory == "news")
+    return EPG_EVENT_CONTENTMASK_NEWSCURRENTAFFAIRS;
+  else if (strCategory == "sport")
+    return EPG_EVENT_CONTENTMASK_SPORTS;
+  else if (strCategory == "series")
+    return EPG_EVENT_CONTENTMASK_SHOW;
+
+  return 0;
+}
+
+// Returns the value of a query parameter of strUrl, empty if it is missing
+std::string GetQueryValue(const std::string& strUrl, const std::string& strName)
+{
+  std::string::size_type nPos = strUrl.find('?');
+
+  while (nPos != std::string::npos)
+  {
+    nPos++;
+    const std::string::size_type nEnd = strUrl.find('&', nPos);
+    if (strUrl.compare(nPos, strName.size(), strName) == 0 && strUrl.compare(nPos + strName.size(), 1, "=") == 0)
+    {
+      const std::string::size_type nValue = nPos + strName.size() + 1;
+      return strUrl.substr(nValue, nEnd == std::string::npos ? std::string::npos : nEnd - nValue);
+    }
+    nPos = nEnd;
+  }
+
+  return "";
+}
+
+} // unnamed namespace
+
+bool Recording::operator==(const Recording& other) const
+{
+  return std::tie(RecordingId, Title, EpisodeTitle, Synopsis, ImageURL, ChannelName, SeriesID, PlayURL,
+                  FirstAired, RecordStartTime, RecordEndTime, SeriesNumber, EpisodeNumber, GenreType) ==
+         std::tie(other.RecordingId, other.Title, other.EpisodeTitle, other.Synopsis, other.ImageURL,
+                  other.ChannelName, other.SeriesID, other.PlayURL, other.FirstAired, other.RecordStartTime,
+                  other.RecordEndTime, other.SeriesNumber, other.EpisodeNumber, other.GenreType);
+}
+
+bool RecordEngine::FetchDetails(const hdhomerun_discover_device_t& device, StorageDetails& details)
+{
+  std::string strJson, jsonReaderError;
+  Json::CharReaderBuilder jsonReaderBuilder;
+  std::unique_ptr<Json::CharReader> const jsonReader(jsonReaderBuilder.newCharReader());
+
+  const std::string strUrl = kodi::tools::StringUtils::Format("%s/discover.json", device.base_url);
+
+  if (!GetFileContents(strUrl, strJson))
+    return false;
+
+  Json::Value jsonDiscover;
+  if (!jsonReader->parse(strJson.c_str(), strJson.c_str() + strJson.size(), &jsonDiscover, &jsonReaderError) ||
+      jsonDiscover.type() != Json::objectValue)
+  {
+    KODI_LOG(ADDON_LOG_ERROR, "Failed to parse storage engine details from %s", strUrl.c_str());
+    return false;
+  }
+
+  details.StorageID = jsonDiscover["StorageID"].asString();
+  details.StorageURL = jsonDiscover["StorageURL"].asString();
+  details.FreeSpace = jsonDiscover["FreeSpace"].asUInt64();
+  details.TotalSpace = jsonDiscover["TotalSpace"].asUInt64();
+
+  return true;
+}
+
+bool RecordEngine::Update(InstrumentedMutex& lock, const StorageDetails& details, const std::atomic<bool>& running)
+{
+  std::string strJson, jsonReaderError;
+  Json::CharReaderBuilder jsonReaderBuilder;
+  std::unique_ptr<Json::CharReader> const jsonReader(jsonReaderBuilder.newCharReader());
+
+  const std::string& strStorageURL = details.StorageURL;
+
+  {
+    std::lock_guard<InstrumentedMutex> lockGuard(lock);
+
+    m_nFreeSpace = details.FreeSpace;
+    m_nTotalSpace = details.TotalSpace;
+  }
+
+  if (strStorageURL.empty())
+    return false;
+
+  //
+  // Recorded series
+  //
+  KODI_LOG(ADDON_LOG_DEBUG, "Requesting HDHomeRun recordings: %s", strStorageURL.c_str());
+
+  Json::Value jsonSeriesList;
+  if (!GetFileContents(strStorageURL, strJson))
+    return false;
+
+  if (!jsonReader->parse(strJson.c_str(), strJson.c_str() + strJson.size(), &jsonSeriesList, &jsonReaderError) ||
+      jsonSeriesList.type() != Json::arrayValue)
+  {
+    KODI_LOG(ADDON_LOG_ERROR, "Failed to parse recordings from %s", strStorageURL.c_str());
+    return false;
+  }
+
+  const time_t tNow = time(nullptr);
+  const bool bFullSync = tNow - m_tLastFullSync >= FullSyncInterval;
+  Json::StreamWriterBuilder jsonWriterBuilder;
+  std::set<std::string> seenSeries;
+  std::map<std::string, Series> changedSeries;
+  std::map<std::string, std::string> unchangedSeries;
+
+  jsonWriterBuilder["indentation"] = "";
+
+  // Only this call modifies m_Series, so it can be read here without the lock
+  for (const auto& jsonSeries : jsonSeriesList)
+  {
+    // The first sync of a large DVR takes a while, do not hold up shutdown
+    if (!running)
+      return false;
+
+    const std::string strEpisodesUrl = jsonSeries["EpisodesURL"].asString();
+    if (strEpisodesUrl.empty())
+      continue;
+
+    std::string strSeriesKey = jsonSeries["SeriesID"].asString();
+    if (strSeriesKey.empty())
+      strSeriesKey = strEpisodesUrl;
+
+    seenSeries.insert(strSeriesKey);
+
+    // The series entry carries the latest recording's start time (and an
+    // update counter on newer firmware), so an unchanged entry means the
+    // episode list does not need to be fetched again. The URL is left out,
+    // an engine that changed address has not changed its recordings.
+    Json::Value jsonSignature = jsonSeries;
+    jsonSignature.removeMember("EpisodesURL");
+    const std::string strSignature = Json::writeString(jsonWriterBuilder, jsonSignature);
+    const auto iterSeries = m_Series.find(strSeriesKey);
+
+    if (!bFullSync && iterSeries != m_Series.end() && iterSeries->second.Signature == strSignature)
+      continue;
+
+    Series series;
+    if (!FetchSeries(strEpisodesUrl, series.Recordings))
+      continue;
+
+    // A full sync fetches every series again, only different episodes are a change
+    if (iterSeries != m_Series.end() && iterSeries->second.Recordings == series.Recordings)
+      unchangedSeries.emplace(strSeriesKey, strSignature);
+    else
+    {
+      series.Signature = strSignature;
+      changedSeries.emplace(strSeriesKey, std::move(series));
+    }
+  }
+
+  bool bChanged = !changedSeries.empty();
+
+  std::lock_guard<InstrumentedMutex> lockGuard(lock);
+
+  for (auto& iterSeries : changedSeries)
+    m_Series[iterSeries.first] = std::move(iterSeries.second);
+
+  // Keeps the recordings, and so the index pointing at them, in place
+  for (const auto& iterSeries : unchangedSeries)
+    m_Series[iterSeries.first].Signature = iterSeries.second;
+
+  for (auto iter = m_Series.begin(); iter != m_Series.end();)
+  {
+    if (seenSeries.find(iter->first) == seenSeries.end())
+    {
+      iter = m_Series.erase(iter);
+      bChanged = true;
+    }
+    else
+      ++iter;
+  }
+
+  m_strStorageURL = strStorageURL;
+  if (bFullSync)
+    m_tLastFullSync = tNow;
+
+  if (bChanged)
+    UpdateIndex();
+
+  KODI_LOG(ADDON_LOG_DEBUG, "Found %u recordings in %u series%s", static_cast<unsigned int>(m_Index.size()),
+           static_cast<unsigned int>(m_Series.size()), bFullSync ? " (full sync)" : "");
+
+  return bChanged;
+}
+
+bool RecordEngine::FetchSeries(const std::string& strEpisodesUrl, std::vector<Recording>& recordings)
+{
+  std::string strJson, jsonReaderError;
+  Json::CharReaderBuilder jsonReaderBuilder;
+  std::unique_ptr<Json::CharReader> const jsonReader(jsonReaderBuilder.newCharReader());
+  Json::Value jsonEpisodes;
+
+  if (!GetFileContents(strEpisodesUrl, strJson))
+    return false;
+
+  if (!jsonReader->parse(strJson.c_str(), strJson.c_str() + strJson.size(), &jsonEpisodes, &jsonReaderError) ||
+      jsonEpisodes.type() != Json::arrayValue)
+  {
+    KODI_LOG(ADDON_LOG_ERROR, "Failed to parse recorded episodes from %s", strEpisodesUrl.c_str());
+    return false;
+  }
+
+  recordings.clear();
+  recordings.reserve(jsonEpisodes.size());
+
+  for (const auto& jsonEpisode : jsonEpisodes)
+  {
+    Recording recording;
+
+    recording.PlayURL = jsonEpisode["PlayURL"].asString();
+    if (recording.PlayURL.empty())
+      continue;
+
+    // The recording ID must survive an address change, so it is built from
+    // the engine's StorageID and the file's id rather than the play URL
+    const std::string strFileId = GetQueryValue(recording.PlayURL, "id");
+    if (!strFileId.empty())
+      recording.RecordingId = m_strStorageID + "/" + strFileId;
+    else
+      recording.RecordingId = m_strStorageID + "/" + jsonEpisode["ProgramID"].asString() + "/" +
+                              std::to_string(jsonEpisode["RecordStartTime"].asUInt());
+
+    // Kept relative to the base URL when possible so a new address applies to it
+    const size_t nBaseURLLength = strlen(m_Device.base_url);
+    if (nBaseURLLength > 0 && recording.PlayURL.compare(0, nBaseURLLength, m_Device.base_url) == 0 &&
+        recording.PlayURL.compare(nBaseURLLength, 1, "/") == 0)
+      recording.PlayURL.erase(0, nBaseURLLength);
+
+    recording.Title = jsonEpisode["Title"].asString();
+    recording.EpisodeTitle = jsonEpisode["EpisodeTitle"].asString();
+    recording.Synopsis = jsonEpisode["Synopsis"].asString();
+    recording.ImageURL = jsonEpisode["ImageURL"].asString();
+    recording.SeriesID = jsonEpisode["SeriesID"].asString();
+    recording.RecordStartTime = static_cast<time_t>(jsonEpisode["RecordStartTime"].asUInt());
+    recording.RecordEndTime = static_cast<time_t>(jsonEpisode["RecordEndTime"].asUInt());
+    recording.GenreType = GetGenreType(jsonEpisode["Category"].asString());
+
+    recording.ChannelName = jsonEpisode["ChannelAffiliate"].asString();
+    if (recording.ChannelName.empty())
+      recording.ChannelName = jsonEpisode["ChannelName"].asString();
+
+    const time_t firstAired = static_cast<time_t>(jsonEpisode["OriginalAirdate"].asUInt());
+    if (firstAired > 0)
+      recording.FirstAired = ParseAsW3CDateString(firstAired);
+
+    ParseEpisodeNumber(jsonEpisode["EpisodeNumber"].asString(), recording.SeriesNumber, recording.EpisodeNumber);
+
+    recordings.emplace_back(std::move(recording));
+  }
+
+  return true;
+}
+
+void RecordEngine::UpdateIndex()
+{
+  m_Index.clear();
+  m_Index.reserve(m_Series.size() * 4);
+
+  for (const auto& series : m_Series)
+    for (const auto& recording : series.second.Recordings)
+      m_Index.emplace(recording.RecordingId, &recording);
+}
+
+std::string RecordEngine::GetPlayURL(const Recording& recording) const
+{
+  if (!recording.PlayURL.empty() && recording.PlayURL.front() == '/')
+    return m_Device.base_url + recording.PlayURL;
+
+  return recording.PlayURL;
+}
+
+const Recording* RecordEngine::FindRecording(const std::string& strRecordingId) const
+{
+  const auto iter = m_Index.find(strRecordingId);
+  return iter != m_Index.end() ? iter->second : nullptr;
+}
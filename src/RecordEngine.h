@@ -0,0 +1,131 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2015 Zoltan Csizmadia (zcsizmadia@gmail.com)
+ *  Copyright (C) 2011 Pulse-Eight (https://www.pulse-eight.com)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include "LatencyStats.h"
+
+#include <atomic>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "hdhomerun.h"
+#include <json/json.h>
+#include <kodi/AddonBase.h>
+#include <kodi/addon-instance/PVR.h>
+
+struct Recording
+{
+  std::string RecordingId;
+  std::string Title;
+  std::string EpisodeTitle;
+  std::string Synopsis;
+  std::string ImageURL;
+  std::string ChannelName;
+  std::string SeriesID;
+  // Relative to the engine's base URL when the engine reports it that way,
+  // see RecordEngine::GetPlayURL()
+  std::string PlayURL;
+  std::string FirstAired;
+  time_t RecordStartTime = 0;
+  time_t RecordEndTime = 0;
+  int SeriesNumber = EPG_TAG_INVALID_SERIES_EPISODE;
+  int EpisodeNumber = EPG_TAG_INVALID_SERIES_EPISODE;
+  unsigned int GenreType = 0;
+
+  bool operator==(const Recording& other) const;
+  bool operator!=(const Recording& other) const { return !(*this == other); }
+};
+
+// Storage engine details from the engine's discover.json
+struct StorageDetails
+{
+  std::string StorageID;
+  std::string StorageURL;
+  uint64_t FreeSpace = 0;
+  uint64_t TotalSpace = 0;
+};
+
+// Local index of the recordings held by one HDHomeRun storage engine (DVR).
+// The index is kept between updates and only series whose entry in the
+// engine's recorded files list changed are fetched again.
+class ATTR_DLL_LOCAL RecordEngine
+{
+public:
+  RecordEngine(const hdhomerun_discover_device_t& device, const std::string& strStorageID)
+    : m_Device(device), m_strStorageID(strStorageID)
+  {
+  }
+
+  // Reads the details of a discovered engine. The StorageID identifies the
+  // engine across address changes, the IP address does not.
+  static bool FetchDetails(const hdhomerun_discover_device_t& device, StorageDetails& details);
+
+  // Synchronises the index with the engine, returns true if it changed.
+  // Fetching happens unlocked, lock is only held while the index is modified;
+  // concurrent Update() calls on the same engine are not allowed. Gives up,
+  // leaving the index as it was, once running turns false.
+  bool Update(InstrumentedMutex& lock, const StorageDetails& details, const std::atomic<bool>& running);
+
+  const hdhomerun_discover_device_t& GetDevice() const { return m_Device; }
+  void SetDevice(const hdhomerun_discover_device_t& device) { m_Device = device; }
+
+  const std::string& GetStorageID() const { return m_strStorageID; }
+
+  time_t GetLastSeen() const { return m_tLastSeen; }
+  void SetLastSeen(time_t tLastSeen) { m_tLastSeen = tLastSeen; }
+
+  // A stale engine was missing from the last discovery, its recordings are
+  // kept but not listed
+  bool IsStale() const { return m_bStale; }
+  void SetStale(bool bStale) { m_bStale = bStale; }
+
+  uint64_t GetFreeSpace() const { return m_nFreeSpace; }
+  uint64_t GetTotalSpace() const { return m_nTotalSpace; }
+
+  size_t GetRecordingCount() const { return m_Index.size(); }
+  const Recording* FindRecording(const std::string& strRecordingId) const;
+  // The recording's stream URL at the engine's current address
+  std::string GetPlayURL(const Recording& recording) const;
+
+  template<typename F>
+  void ForEachRecording(F&& func) const
+  {
+    for (const auto& series : m_Series)
+      for (const auto& recording : series.second.Recordings)
+        func(recording);
+  }
+
+private:
+  struct Series
+  {
+    std::string Signature;
+    std::vector<Recording> Recordings;
+  };
+
+  bool FetchSeries(const std::string& strEpisodesUrl, std::vector<Recording>& recordings);
+  void UpdateIndex();
+
+  hdhomerun_discover_device_t m_Device;
+  std::string m_strStorageID;
+  std::string m_strStorageURL;
+  uint64_t m_nFreeSpace = 0;
+  uint64_t m_nTotalSpace = 0;
+  time_t m_tLastFullSync = 0;
+  time_t m_tLastSeen = 0;
+  bool m_bStale = false;
+
+  // Keyed by SeriesID, the EpisodesURL carries the engine's address
+  std::map<std::string, Series> m_Series;
+  std::unordered_map<std::string, const Recording*> m_Index;
+};
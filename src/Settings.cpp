@@ -22,6 +22,15 @@ bool SettingsType::ReadSettings()
   bMarkNew = kodi::addon::GetSettingBoolean("mark_new", true);
   bDebug = kodi::addon::GetSettingBoolean("debug", false);
   bHttpDiscovery = kodi::addon::GetSettingBoolean("http_discovery", false);
+  bTimeshift = kodi::addon::GetSettingBoolean("timeshift", false);
+  iTimeshiftBufferSizeMB = kodi::addon::GetSettingInt("timeshift_buffer_size", 512);
+  iTranscode = kodi::addon::GetSettingInt("transcode", 0);
+  iTranscodeHeavyBelow = kodi::addon::GetSettingInt("transcode_heavy_below", 16);
+  iTranscodeMobileBelow = kodi::addon::GetSettingInt("transcode_mobile_below", 8);
+  iTranscodeInternetBelow = kodi::addon::GetSettingInt("transcode_internet_below", 4);
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  strTimeshiftPath = kodi::addon::GetSettingString("timeshift_path", "special://userdata/addon_data/pvr.hdhomerun/timeshift/");
 
   return true;
 }
@@ -30,24 +39,36 @@ ADDON_STATUS SettingsType::SetSetting(const std::string& settingName,
                                       const kodi::addon::CSettingValue& settingValue)
 {
   if (settingName == "hide_protected")
-  {
     bHideProtected = settingValue.GetBoolean();
-    return ADDON_STATUS_NEED_RESTART;
-  }
   else if (settingName == "hide_duplicate")
-  {
     bHideDuplicateChannels = settingValue.GetBoolean();
-    return ADDON_STATUS_NEED_RESTART;
-  }
   else if (settingName == "mark_new")
     bMarkNew = settingValue.GetBoolean();
   else if (settingName == "debug")
     bDebug = settingValue.GetBoolean();
   else if (settingName == "http_discovery")
-  {
     bHttpDiscovery = settingValue.GetBoolean();
+  else if (settingName == "timeshift")
+  {
+    // Changes whether the add-on handles the input stream itself
+    bTimeshift = settingValue.GetBoolean();
     return ADDON_STATUS_NEED_RESTART;
   }
+  else if (settingName == "timeshift_buffer_size")
+    iTimeshiftBufferSizeMB = settingValue.GetInt();
+  else if (settingName == "transcode")
+    iTranscode = settingValue.GetInt();
+  else if (settingName == "transcode_heavy_below")
+    iTranscodeHeavyBelow = settingValue.GetInt();
+  else if (settingName == "transcode_mobile_below")
+    iTranscodeMobileBelow = settingValue.GetInt();
+  else if (settingName == "transcode_internet_below")
+    iTranscodeInternetBelow = settingValue.GetInt();
+  else if (settingName == "timeshift_path")
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    strTimeshiftPath = settingValue.GetString();
+  }
 
   return ADDON_STATUS_OK;
 }
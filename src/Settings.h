@@ -9,7 +9,10 @@
 
 #pragma once
 
+#include <atomic>
 #include <kodi/AddonBase.h>
+#include <mutex>
+#include <string>
 
 class ATTR_DLL_LOCAL SettingsType
 {
@@ -24,13 +27,36 @@ public:
   bool GetDebug() const { return bDebug; }
   bool GetMarkNew() const { return bMarkNew; }
   bool GetHttpDiscovery() const { return bHttpDiscovery; }
+  bool GetTimeshift() const { return bTimeshift; }
+  int64_t GetTimeshiftBufferSize() const { return static_cast<int64_t>(iTimeshiftBufferSizeMB) * 1024 * 1024; }
+  std::string GetTimeshiftPath() const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return strTimeshiftPath;
+  }
+  // 0 = off, 1 = automatic, 2 and up select a fixed profile
+  int GetTranscode() const { return iTranscode; }
+  // Throughput thresholds in Mbit/s for the automatic profile selection, applied
+  // to the rate a stream is delivered at once it falls behind real time
+  int GetTranscodeHeavyBelow() const { return iTranscodeHeavyBelow; }
+  int GetTranscodeMobileBelow() const { return iTranscodeMobileBelow; }
+  int GetTranscodeInternetBelow() const { return iTranscodeInternetBelow; }
 
 private:
   SettingsType() = default;
 
-  bool bHideProtected = true;
-  bool bHideDuplicateChannels = true;
-  bool bDebug = false;
-  bool bMarkNew = false;
-  bool bHttpDiscovery = false;
+  // Settings are changed on Kodi's thread and read from the add-on's update thread
+  std::atomic<bool> bHideProtected = {true};
+  std::atomic<bool> bHideDuplicateChannels = {true};
+  std::atomic<bool> bDebug = {false};
+  std::atomic<bool> bMarkNew = {false};
+  std::atomic<bool> bHttpDiscovery = {false};
+  std::atomic<bool> bTimeshift = {false};
+  std::atomic<int> iTimeshiftBufferSizeMB = {512};
+  std::atomic<int> iTranscode = {0};
+  std::atomic<int> iTranscodeHeavyBelow = {16};
+  std::atomic<int> iTranscodeMobileBelow = {8};
+  std::atomic<int> iTranscodeInternetBelow = {4};
+  mutable std::mutex m_mutex;
+  std::string strTimeshiftPath;
 };
@@ -0,0 +1,95 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2015 Zoltan Csizmadia (zcsizmadia@gmail.com)
+ *  Copyright (C) 2011 Pulse-Eight (https://www.pulse-eight.com)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "StreamRate.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+
+constexpr double PcrTicksPerSecond = 27000000.0;
+
+} // unnamed namespace
+
+void StreamRate::Add(const char* pData, size_t nSize, Clock::time_point arrival)
+{
+  const uint8_t* pBytes = reinterpret_cast<const uint8_t*>(pData);
+
+  while (nSize > 0)
+  {
+    // Resynchronise on the next sync byte if a packet does not start with one
+    if (m_nPacketUsed == 0 && *pBytes != SyncByte)
+    {
+      pBytes++;
+      nSize--;
+      m_nBytes++;
+      continue;
+    }
+
+    const size_t nLength = std::min(nSize, PacketSize - m_nPacketUsed);
+    memcpy(m_Packet + m_nPacketUsed, pBytes, nLength);
+    m_nPacketUsed += nLength;
+    m_nBytes += nLength;
+    pBytes += nLength;
+    nSize -= nLength;
+
+    if (m_nPacketUsed == PacketSize)
+    {
+      AddPacket(m_Packet, arrival);
+      m_nPacketUsed = 0;
+    }
+  }
+}
+
+void StreamRate::AddPacket(const uint8_t* pPacket, Clock::time_point arrival)
+{
+  // Adaptation field with the PCR flag set
+  const int nPid = ((pPacket[1] & 0x1F) << 8) | pPacket[2];
+  if ((pPacket[3] & 0x20) == 0 || pPacket[4] < 7 || (pPacket[5] & 0x10) == 0)
+    return;
+
+  if (m_nPcrPid < 0)
+    m_nPcrPid = nPid;
+  else if (nPid != m_nPcrPid)
+    return;
+
+  const int64_t nBase = (static_cast<int64_t>(pPacket[6]) << 25) | (pPacket[7] << 17) | (pPacket[8] << 9) |
+                        (pPacket[9] << 1) | (pPacket[10] >> 7);
+  const int64_t nPcr = nBase * 300 + (((pPacket[10] & 0x01) << 8) | pPacket[11]);
+
+  // A wrap or discontinuity starts the measurement over
+  if (m_nFirstPcr < 0 || nPcr < m_nLastPcr)
+  {
+    m_nFirstPcr = nPcr;
+    m_nFirstPcrBytes = m_nBytes;
+    m_FirstPcrArrival = arrival;
+  }
+
+  m_nLastPcr = nPcr;
+  m_nLastPcrBytes = m_nBytes;
+  m_LastPcrArrival = arrival;
+}
+
+double StreamRate::GetStreamSeconds() const
+{
+  return m_nFirstPcr < 0 ? 0 : (m_nLastPcr - m_nFirstPcr) / PcrTicksPerSecond;
+}
+
+double StreamRate::GetWallSeconds() const
+{
+  return m_nFirstPcr < 0 ? 0 : std::chrono::duration<double>(m_LastPcrArrival - m_FirstPcrArrival).count();
+}
+
+double StreamRate::GetDeliveredMbps() const
+{
+  const double dSeconds = GetWallSeconds();
+  return dSeconds > 0 ? (m_nLastPcrBytes - m_nFirstPcrBytes) * 8 / dSeconds / 1000000 : 0;
+}
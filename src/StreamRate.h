@@ -0,0 +1,58 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2015 Zoltan Csizmadia (zcsizmadia@gmail.com)
+ *  Copyright (C) 2011 Pulse-Eight (https://www.pulse-eight.com)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+#include <kodi/AddonBase.h>
+
+// Compares how fast a live transport stream arrives with its own clock.
+//
+// A device sends a live stream at the broadcast bitrate, so the delivered
+// rate alone only tells how fast the channel is. A link that cannot keep up
+// shows instead as the stream's clock (its PCR) advancing slower than the
+// wall clock; the rate delivered then is what the link manages.
+class ATTR_DLL_LOCAL StreamRate
+{
+public:
+  using Clock = std::chrono::steady_clock;
+
+  // Feeds received stream data, split anywhere, with its arrival time
+  void Add(const char* pData, size_t nSize, Clock::time_point arrival);
+
+  // Seconds of stream clock between the first and the last PCR seen, and the
+  // wall clock seconds between their arrival
+  double GetStreamSeconds() const;
+  double GetWallSeconds() const;
+
+  // Mbit/s delivered between the first and the last PCR
+  double GetDeliveredMbps() const;
+
+private:
+  static constexpr size_t PacketSize = 188;
+  static constexpr uint8_t SyncByte = 0x47;
+
+  void AddPacket(const uint8_t* pPacket, Clock::time_point arrival);
+
+  uint8_t m_Packet[PacketSize] = {};
+  size_t m_nPacketUsed = 0;
+  uint64_t m_nBytes = 0;
+
+  // The clock of the first PID seen carrying one, in 27 MHz ticks
+  int m_nPcrPid = -1;
+  int64_t m_nFirstPcr = -1;
+  int64_t m_nLastPcr = -1;
+  uint64_t m_nFirstPcrBytes = 0;
+  uint64_t m_nLastPcrBytes = 0;
+  Clock::time_point m_FirstPcrArrival;
+  Clock::time_point m_LastPcrArrival;
+};
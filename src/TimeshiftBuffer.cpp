@@ -0,0 +1,335 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2015 Zoltan Csizmadia (zcsizmadia@gmail.com)
+ *  Copyright (C) 2011 Pulse-Eight (https://www.pulse-eight.com)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "TimeshiftBuffer.h"
+#include "Utils.h"
+
+#include <chrono>
+#include <cstring>
+
+namespace
+{
+
+// How long a read waits for the device before reporting the end of the stream
+constexpr std::chrono::seconds ReadTimeout(10);
+
+// Kodi's "can this stream seek" query
+constexpr int SeekPossible = 0x10;
+
+} // unnamed namespace
+
+TimeshiftBuffer::~TimeshiftBuffer()
+{
+  Close();
+}
+
+std::string TimeshiftBuffer::GetBufferFile(const std::string& strBufferPath)
+{
+  std::string strFile = strBufferPath;
+  if (!strFile.empty() && strFile.back() != '/' && strFile.back() != '\\')
+    strFile += '/';
+
+  if (!kodi::vfs::DirectoryExists(strFile) && !kodi::vfs::CreateDirectory(strFile))
+  {
+    KODI_LOG(ADDON_LOG_ERROR, "Timeshift: unable to create buffer directory %s", strFile.c_str());
+    return "";
+  }
+
+  return strFile + "timeshift.ts";
+}
+
+bool TimeshiftBuffer::Prepare(const std::string& strBufferPath, int64_t nBufferSize, const std::atomic<bool>& running)
+{
+  const std::string strFile = GetBufferFile(strBufferPath);
+  if (strFile.empty())
+    return false;
+
+  // The ring file is kept between sessions, only a new size writes it again
+  kodi::vfs::CFile file;
+  if (!file.OpenFileForWrite(strFile, false))
+  {
+    KODI_LOG(ADDON_LOG_ERROR, "Timeshift: unable to open buffer file %s", strFile.c_str());
+    return false;
+  }
+
+  if (file.GetLength() == nBufferSize)
+    return true;
+
+  // Truncate() would leave a sparse file, so a full disk would only show up as
+  // a failed write in the middle of playback. Write the whole ring once instead;
+  // if that fails the file is left empty, so the next start tries again.
+  KODI_LOG(ADDON_LOG_DEBUG, "Timeshift: allocating %lld bytes for %s", static_cast<long long>(nBufferSize),
+           strFile.c_str());
+
+  if (file.Truncate(0) != 0 || file.Seek(0, SEEK_SET) != 0)
+    return false;
+
+  std::unique_ptr<char[]> chunk(new char[ChunkSize]());
+
+  for (int64_t nWritten = 0; nWritten < nBufferSize;)
+  {
+    const size_t nLength = static_cast<size_t>(std::min<int64_t>(ChunkSize, nBufferSize - nWritten));
+
+    if (!running || file.Write(chunk.get(), nLength) != static_cast<ssize_t>(nLength))
+    {
+      if (running)
+        KODI_LOG(ADDON_LOG_ERROR, "Timeshift: unable to allocate %lld bytes for %s",
+                 static_cast<long long>(nBufferSize), strFile.c_str());
+      file.Truncate(0);
+      return false;
+    }
+
+    nWritten += nLength;
+  }
+
+  file.Flush();
+  return true;
+}
+
+bool TimeshiftBuffer::Open(const std::string& strStreamUrl, const std::string& strBufferPath, int64_t nBufferSize)
+{
+  Close();
+
+  const std::string strFile = GetBufferFile(strBufferPath);
+  if (strFile.empty())
+    return false;
+
+  // The ring file is never grown while a stream is buffered
+  if (!m_WriteFile.OpenFileForWrite(strFile, false))
+  {
+    KODI_LOG(ADDON_LOG_ERROR, "Timeshift: unable to open buffer file %s", strFile.c_str());
+    return false;
+  }
+
+  if (m_WriteFile.GetLength() != nBufferSize)
+  {
+    KODI_LOG(ADDON_LOG_ERROR, "Timeshift: buffer file %s is not prepared for %lld bytes", strFile.c_str(),
+             static_cast<long long>(nBufferSize));
+    m_WriteFile.Close();
+    return false;
+  }
+
+  if (!m_ChunkBuffer)
+    m_ChunkBuffer.reset(new char[ChunkSize]);
+
+  if (!m_ReadFile.OpenFile(strFile, ADDON_READ_NO_CACHE))
+  {
+    KODI_LOG(ADDON_LOG_ERROR, "Timeshift: unable to read buffer file %s", strFile.c_str());
+    m_WriteFile.Close();
+    return false;
+  }
+
+  if (!m_Stream.CURLCreate(strStreamUrl) || !m_Stream.CURLOpen(ADDON_READ_NO_CACHE))
+  {
+    KODI_LOG(ADDON_LOG_ERROR, "Timeshift: unable to open stream %s", strStreamUrl.c_str());
+    m_ReadFile.Close();
+    m_WriteFile.Close();
+    return false;
+  }
+
+  m_nBufferSize = nBufferSize;
+  m_nWritePos = 0;
+  m_nWriteEnd = 0;
+  m_nReadPos = 0;
+  m_bEndOfStream = false;
+  m_Index.assign(IndexSize, IndexEntry{0, 0});
+  m_nIndexCount = 0;
+
+  KODI_LOG(ADDON_LOG_DEBUG, "Timeshift: buffering %s into %s (%lld bytes)", strStreamUrl.c_str(),
+           strFile.c_str(), static_cast<long long>(nBufferSize));
+
+  m_running = true;
+  m_thread = std::thread([&] { Process(); });
+
+  return true;
+}
+
+void TimeshiftBuffer::Close()
+{
+  m_running = false;
+  m_condition.notify_all();
+
+  if (m_thread.joinable())
+    m_thread.join();
+
+  m_Stream.Close();
+  m_ReadFile.Close();
+  m_WriteFile.Close();
+}
+
+void TimeshiftBuffer::Process()
+{
+  while (m_running)
+  {
+    const ssize_t nRead = m_Stream.Read(m_ChunkBuffer.get(), ChunkSize);
+    if (nRead <= 0)
+      break;
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_nWriteEnd = m_nWritePos + nRead;
+    }
+
+    // Only this thread moves the write position, so it can be read unlocked here
+    size_t nDone = 0;
+    while (nDone < static_cast<size_t>(nRead))
+    {
+      const int64_t nOffset = (m_nWritePos + nDone) % m_nBufferSize;
+      const size_t nLength = static_cast<size_t>(
+          std::min<int64_t>(nRead - nDone, m_nBufferSize - nOffset));
+
+      if (m_WriteFile.Seek(nOffset, SEEK_SET) != nOffset ||
+          m_WriteFile.Write(m_ChunkBuffer.get() + nDone, nLength) != static_cast<ssize_t>(nLength))
+        break;
+
+      nDone += nLength;
+    }
+
+    if (nDone != static_cast<size_t>(nRead))
+    {
+      KODI_LOG(ADDON_LOG_ERROR, "Timeshift: failed to write to buffer file");
+      break;
+    }
+
+    const time_t now = time(nullptr);
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+
+      if (m_nIndexCount == 0 || m_Index[(m_nIndexCount - 1) % IndexSize].Time != now)
+        m_Index[m_nIndexCount++ % IndexSize] = IndexEntry{m_nWritePos, now};
+
+      m_nWritePos += nRead;
+    }
+    m_condition.notify_all();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_bEndOfStream = true;
+  }
+  m_condition.notify_all();
+}
+
+int TimeshiftBuffer::Read(unsigned char* pBuffer, unsigned int nSize)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  for (;;)
+  {
+    m_condition.wait_for(lock, ReadTimeout,
+                         [this] { return m_nReadPos < m_nWritePos || m_bEndOfStream || !m_running; });
+
+    if (m_nReadPos >= m_nWritePos)
+      return 0;
+
+    // Data not read while paused for longer than the buffer holds is lost;
+    // continue with the oldest data still available
+    if (m_nReadPos < GetStartPosition())
+      m_nReadPos = GetStartPosition();
+
+    const int64_t nReadPos = m_nReadPos;
+    const int64_t nOffset = nReadPos % m_nBufferSize;
+    const size_t nLength = static_cast<size_t>(
+        std::min<int64_t>({static_cast<int64_t>(nSize), m_nWritePos - nReadPos, m_nBufferSize - nOffset}));
+
+    lock.unlock();
+
+    ssize_t nRead = -1;
+    if (m_ReadFile.Seek(nOffset, SEEK_SET) == nOffset)
+      nRead = m_ReadFile.Read(pBuffer, nLength);
+
+    lock.lock();
+
+    if (nRead <= 0)
+      return -1;
+
+    // The writer may have wrapped over this region while it was being read;
+    // it publishes the region before writing, so any overlap shows up here
+    if (nReadPos < GetStartPosition())
+      continue;
+
+    // Only move on if no seek happened meanwhile
+    if (m_nReadPos == nReadPos)
+      m_nReadPos = nReadPos + nRead;
+
+    return static_cast<int>(nRead);
+  }
+}
+
+int64_t TimeshiftBuffer::Seek(int64_t nPosition, int nWhence)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  if (nWhence == SeekPossible)
+    return 1;
+
+  int64_t nTarget;
+  switch (nWhence)
+  {
+    case SEEK_SET:
+      nTarget = nPosition;
+      break;
+    case SEEK_CUR:
+      nTarget = m_nReadPos + nPosition;
+      break;
+    case SEEK_END:
+      nTarget = m_nWritePos + nPosition;
+      break;
+    default:
+      return -1;
+  }
+
+  m_nReadPos = std::max(GetStartPosition(), std::min(nTarget, m_nWritePos));
+  return m_nReadPos;
+}
+
+int64_t TimeshiftBuffer::GetLength() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_nWritePos;
+}
+
+time_t TimeshiftBuffer::GetTimeAt(int64_t nPosition) const
+{
+  if (m_nIndexCount == 0)
+    return time(nullptr);
+
+  // Binary search the samples still in the ring for the last one at or before nPosition
+  size_t nFirst = m_nIndexCount > IndexSize ? m_nIndexCount - IndexSize : 0;
+  size_t nLast = m_nIndexCount;
+
+  while (nLast - nFirst > 1)
+  {
+    const size_t nMiddle = nFirst + (nLast - nFirst) / 2;
+    if (m_Index[nMiddle % IndexSize].Position <= nPosition)
+      nFirst = nMiddle;
+    else
+      nLast = nMiddle;
+  }
+
+  return m_Index[nFirst % IndexSize].Time;
+}
+
+time_t TimeshiftBuffer::GetStartTime() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return GetTimeAt(GetStartPosition());
+}
+
+time_t TimeshiftBuffer::GetReadTime() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return GetTimeAt(m_nReadPos);
+}
+
+time_t TimeshiftBuffer::GetEndTime() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return GetTimeAt(m_nWritePos);
+}
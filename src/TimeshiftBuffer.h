@@ -0,0 +1,92 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2015 Zoltan Csizmadia (zcsizmadia@gmail.com)
+ *  Copyright (C) 2011 Pulse-Eight (https://www.pulse-eight.com)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <kodi/Filesystem.h>
+
+// Spools a live transport stream into a fixed-size ring file on disk so
+// playback can be paused and seeked without going back to the device.
+//
+// Positions handed out are logical byte offsets since the stream was
+// opened; only the last GetBufferSize() bytes of them can be read back.
+class ATTR_DLL_LOCAL TimeshiftBuffer
+{
+public:
+  TimeshiftBuffer() = default;
+  ~TimeshiftBuffer();
+
+  // Creates or resizes the ring file so that Open() does not have to. The
+  // whole file is written once, which can take minutes on slow storage, so
+  // this runs on the add-on's thread and gives up when running turns false.
+  static bool Prepare(const std::string& strBufferPath, int64_t nBufferSize, const std::atomic<bool>& running);
+
+  // Fails if the ring file has not been prepared for nBufferSize
+  bool Open(const std::string& strStreamUrl, const std::string& strBufferPath, int64_t nBufferSize);
+  void Close();
+
+  int Read(unsigned char* pBuffer, unsigned int nSize);
+  int64_t Seek(int64_t nPosition, int nWhence);
+  int64_t GetLength() const;
+
+  // Wall clock times of the oldest buffered data, the read position and
+  // the newest data, taken from the position index
+  time_t GetStartTime() const;
+  time_t GetReadTime() const;
+  time_t GetEndTime() const;
+
+private:
+  struct IndexEntry
+  {
+    int64_t Position;
+    time_t Time;
+  };
+
+  static constexpr size_t ChunkSize = 64 * 1024;
+  static constexpr size_t IndexSize = 4 * 60 * 60;
+
+  static std::string GetBufferFile(const std::string& strBufferPath);
+  void Process();
+  // The oldest readable position; the region the writer is overwriting is excluded
+  int64_t GetStartPosition() const { return std::max<int64_t>(0, m_nWriteEnd - m_nBufferSize); }
+  time_t GetTimeAt(int64_t nPosition) const;
+
+  kodi::vfs::CFile m_Stream;
+  kodi::vfs::CFile m_WriteFile;
+  kodi::vfs::CFile m_ReadFile;
+  int64_t m_nBufferSize = 0;
+
+  // Logical positions; m_nWritePos is also the length of the stream so far.
+  // m_nWriteEnd is published before a chunk is written, so the part of the
+  // ring being overwritten is no longer readable while the write is going on.
+  int64_t m_nWritePos = 0;
+  int64_t m_nWriteEnd = 0;
+  int64_t m_nReadPos = 0;
+  bool m_bEndOfStream = false;
+
+  // One sample per second of stream, a ring over the last IndexSize seconds
+  std::vector<IndexEntry> m_Index;
+  size_t m_nIndexCount = 0;
+
+  std::unique_ptr<char[]> m_ChunkBuffer;
+  std::atomic<bool> m_running = {false};
+  std::thread m_thread;
+  mutable std::mutex m_mutex;
+  std::condition_variable m_condition;
+};
@@ -9,9 +9,15 @@
 
 #include "Utils.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <kodi/addon-instance/PVR.h>
 #include <kodi/Filesystem.h>
 #include <kodi/tools/StringUtils.h>
 #include <string>
+#include <thread>
 
 #if defined(USE_DBG_CONSOLE) && defined(TARGET_WINDOWS)
 int DbgPrintf(const char* szFormat, ...)
@@ -37,28 +43,120 @@ int DbgPrintf(const char* szFormat, ...)
 }
 #endif
 
-bool GetFileContents(const std::string& url, std::string& strContent)
+namespace
+{
+
+constexpr int FetchAttempts = 3;
+constexpr int FetchConnectTimeoutSeconds = 5;
+constexpr int FetchRetryDelayMilliseconds = 500;
+constexpr size_t FetchChunkSize = 16 * 1024;
+
+enum class FetchResult
+{
+  Success,
+  Retry,
+  Failed
+};
+
+// One attempt at fetching url; the connection goes back to Kodi's curl
+// session pool on close, so repeated requests to a device reuse it
+FetchResult FetchFileContents(const std::string& url, std::string& strContent,
+                              const std::chrono::steady_clock::time_point& deadline)
 {
   kodi::vfs::CFile fileHandle;
 
-  if (!fileHandle.OpenFile(url))
+  // Connecting may only use what is left of the budget
+  const auto remaining = std::chrono::duration_cast<std::chrono::seconds>(deadline - std::chrono::steady_clock::now());
+  if (remaining.count() <= 0)
+  {
+    KODI_LOG(ADDON_LOG_ERROR, "GetFileContents: %s timed out", url.c_str());
+    return FetchResult::Failed;
+  }
+
+  if (!fileHandle.CURLCreate(url))
+    return FetchResult::Failed;
+
+  // Errors are reported through the response code, so client errors are not retried
+  fileHandle.CURLAddOption(ADDON_CURL_OPTION_PROTOCOL, "failonerror", "false");
+  fileHandle.CURLAddOption(ADDON_CURL_OPTION_PROTOCOL, "acceptencoding", "gzip, deflate");
+  fileHandle.CURLAddOption(ADDON_CURL_OPTION_PROTOCOL, "connection-timeout",
+                           std::to_string(std::min<long long>(FetchConnectTimeoutSeconds, remaining.count())));
+
+  if (!fileHandle.CURLOpen(ADDON_READ_NO_CACHE))
+    return FetchResult::Retry;
+
+  int nResponseCode = -1;
+  const std::string strProtocol = fileHandle.GetPropertyValue(ADDON_FILE_PROPERTY_RESPONSE_PROTOCOL, "");
+  const std::string::size_type nPos = strProtocol.find(' ');
+  if (nPos != std::string::npos)
+    nResponseCode = atoi(strProtocol.c_str() + nPos + 1);
+
+  if (nResponseCode >= 400)
   {
-    KODI_LOG(ADDON_LOG_ERROR, "GetFileContents: %s failed\n", url.c_str());
-    return false;
+    KODI_LOG(ADDON_LOG_ERROR, "GetFileContents: %s returned %d", url.c_str(), nResponseCode);
+    return nResponseCode < 500 ? FetchResult::Failed : FetchResult::Retry;
   }
 
-  char buffer[1024];
+  // Content-Length is the compressed size for gzip transfers, still a useful lower bound
+  const int64_t nLength = fileHandle.GetLength();
   strContent.clear();
+  if (nLength > 0)
+    strContent.reserve(static_cast<size_t>(nLength));
+
+  char buffer[FetchChunkSize];
 
   for (;;)
   {
     ssize_t bytesRead = fileHandle.Read(buffer, sizeof(buffer));
-    if (bytesRead <= 0)
+    if (bytesRead < 0)
+      return FetchResult::Retry;
+    if (bytesRead == 0)
       break;
     strContent.append(buffer, bytesRead);
+
+    if (std::chrono::steady_clock::now() > deadline)
+    {
+      KODI_LOG(ADDON_LOG_ERROR, "GetFileContents: %s timed out", url.c_str());
+      return FetchResult::Failed;
+    }
+  }
+
+  return FetchResult::Success;
+}
+
+} // unnamed namespace
+
+bool GetFileContents(const std::string& url, std::string& strContent, int nTimeoutSeconds)
+{
+  // One deadline for all attempts: no attempt or retry starts after it and
+  // connecting is bounded by what is left of it. Kodi's curl options have no
+  // overall timeout though, so a server that stalls after the connection is
+  // made is only cut off by curl's low speed limit, which can overrun it.
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(nTimeoutSeconds);
+
+  for (int nAttempt = 0; nAttempt < FetchAttempts; nAttempt++)
+  {
+    if (nAttempt > 0)
+    {
+      const auto delay = std::chrono::milliseconds(FetchRetryDelayMilliseconds << (nAttempt - 1));
+      if (std::chrono::steady_clock::now() + delay >= deadline)
+        break;
+
+      KODI_LOG(ADDON_LOG_DEBUG, "GetFileContents: retrying %s in %d ms", url.c_str(),
+               static_cast<int>(delay.count()));
+      std::this_thread::sleep_for(delay);
+    }
+
+    const FetchResult result = FetchFileContents(url, strContent, deadline);
+    if (result == FetchResult::Success)
+      return true;
+    if (result == FetchResult::Failed)
+      break;
   }
 
-  return true;
+  KODI_LOG(ADDON_LOG_ERROR, "GetFileContents: %s failed\n", url.c_str());
+  strContent.clear();
+  return false;
 }
 
 std::string EncodeURL(const std::string& strUrl)
@@ -77,3 +175,31 @@ std::string EncodeURL(const std::string& strUrl)
 
   return str;
 }
+
+std::string ParseAsW3CDateString(time_t time)
+{
+  std::tm tm = {};
+#ifdef TARGET_WINDOWS
+  if (gmtime_s(&tm, &time) != 0)
+    return "";
+#else
+  if (gmtime_r(&time, &tm) == nullptr)
+    return "";
+#endif
+
+  char buffer[16];
+  std::strftime(buffer, 16, "%Y-%m-%d", &tm);
+
+  return buffer;
+}
+
+void ParseEpisodeNumber(const std::string& strEpisodeNumber, int& iSeriesNumber, int& iEpisodeNumber)
+{
+  iSeriesNumber = EPG_TAG_INVALID_SERIES_EPISODE;
+  iEpisodeNumber = EPG_TAG_INVALID_SERIES_EPISODE;
+
+  if (sscanf(strEpisodeNumber.c_str(), "S%dE%d", &iSeriesNumber, &iEpisodeNumber) != 2)
+    if (sscanf(strEpisodeNumber.c_str(), "EP%d-%d", &iSeriesNumber, &iEpisodeNumber) != 2)
+      if (sscanf(strEpisodeNumber.c_str(), "EP%d", &iEpisodeNumber) == 1)
+        iSeriesNumber = EPG_TAG_INVALID_SERIES_EPISODE;
+}
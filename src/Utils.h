@@ -11,6 +11,7 @@
 
 #include "Settings.h"
 
+#include <ctime>
 #include <kodi/General.h>
 #include <string>
 
@@ -34,6 +35,16 @@ int DbgPrintf(const char* szFormat, ...);
             kodi::Log(level, __VA_ARGS__);        \
   } while (0)
 
-bool GetFileContents(const std::string& url, std::string& strContent);
+// Fetches url (requesting a compressed transfer), retrying server and
+// network errors with backoff. No attempt starts after nTimeoutSeconds, a
+// stalled transfer may still run over until curl's low speed limit hits.
+bool GetFileContents(const std::string& url, std::string& strContent, int nTimeoutSeconds = 30);
 
 std::string EncodeURL(const std::string& strUrl);
+
+// Formats the UTC date of time as YYYY-MM-DD
+std::string ParseAsW3CDateString(time_t time);
+
+// Splits "S01E02", "EP01-02" or "EP02" style episode numbers,
+// EPG_TAG_INVALID_SERIES_EPISODE when absent
+void ParseEpisodeNumber(const std::string& strEpisodeNumber, int& iSeriesNumber, int& iEpisodeNumber);
@@ -0,0 +1,419 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2015 Zoltan Csizmadia (zcsizmadia@gmail.com)
+ *  Copyright (C) 2011 Pulse-Eight (https://www.pulse-eight.com)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "HttpFixture.h"
+#include "KodiStub.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "hdhomerun.h"
+#include <json/json.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+namespace
+{
+
+constexpr uint32_t FirstDeviceID = 0x10A00001;
+constexpr time_t SlotLength = 30 * 60;
+
+std::string GetBaseURL(const char* szDevice, int nDevice)
+{
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "http://127.0.0.1:%d/%s%d", stress::GetFixturePort(), szDevice, nDevice);
+  return buffer;
+}
+
+// Tuner 1 carries channels 0 .. ChannelCount-1, tuner 2 the same shifted by 10
+int GetChannel(int nTuner, int nIndex)
+{
+  return nIndex + (nTuner - 1) * 10;
+}
+
+std::string GetGuideNumber(int nChannel)
+{
+  char buffer[16];
+  snprintf(buffer, sizeof(buffer), "%d.%d", 2 + nChannel / 4, 1 + nChannel % 4);
+  return buffer;
+}
+
+std::string Write(const Json::Value& json)
+{
+  Json::StreamWriterBuilder jsonWriterBuilder;
+  jsonWriterBuilder["indentation"] = "";
+  return Json::writeString(jsonWriterBuilder, json);
+}
+
+} // unnamed namespace
+
+int HttpFixture::Start()
+{
+  m_nListen = socket(AF_INET, SOCK_STREAM, 0);
+  if (m_nListen < 0)
+    return 0;
+
+  const int nReuse = 1;
+  setsockopt(m_nListen, SOL_SOCKET, SO_REUSEADDR, &nReuse, sizeof(nReuse));
+
+  struct sockaddr_in addr = {};
+  socklen_t nAddrLength = sizeof(addr);
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  if (bind(m_nListen, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0 ||
+      listen(m_nListen, 128) != 0 ||
+      getsockname(m_nListen, reinterpret_cast<struct sockaddr*>(&addr), &nAddrLength) != 0)
+  {
+    close(m_nListen);
+    m_nListen = -1;
+    return 0;
+  }
+
+  m_nPort = ntohs(addr.sin_port);
+  m_tStart = time(nullptr) / SlotLength * SlotLength - 2 * SlotLength;
+  m_running = true;
+
+  m_AcceptThread = std::thread([this] { Accept(); });
+  for (int nWorker = 0; nWorker < WorkerCount; nWorker++)
+    m_Workers.emplace_back([this] { Work(); });
+
+  return m_nPort;
+}
+
+void HttpFixture::Stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_running = false;
+  }
+  m_condition.notify_all();
+
+  if (m_nListen >= 0)
+    shutdown(m_nListen, SHUT_RDWR);
+
+  if (m_AcceptThread.joinable())
+    m_AcceptThread.join();
+  for (auto& worker : m_Workers)
+    worker.join();
+  m_Workers.clear();
+
+  if (m_nListen >= 0)
+    close(m_nListen);
+  m_nListen = -1;
+
+  for (const int fd : m_Connections)
+    close(fd);
+  m_Connections.clear();
+}
+
+void HttpFixture::Accept()
+{
+  while (m_running)
+  {
+    const int fd = accept(m_nListen, nullptr, nullptr);
+    if (fd < 0)
+      break;
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_Connections.push_back(fd);
+    }
+    m_condition.notify_one();
+  }
+}
+
+void HttpFixture::Work()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  for (;;)
+  {
+    m_condition.wait(lock, [this] { return !m_running || !m_Connections.empty(); });
+    if (!m_running)
+      break;
+
+    const int fd = m_Connections.front();
+    m_Connections.pop_front();
+
+    lock.unlock();
+    Handle(fd);
+    lock.lock();
+  }
+}
+
+void HttpFixture::Handle(int fd)
+{
+  struct timeval timeout = {5, 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  std::string strRequest;
+  char buffer[4096];
+
+  while (strRequest.find("\r\n\r\n") == std::string::npos && strRequest.size() < 16384)
+  {
+    const ssize_t nRead = recv(fd, buffer, sizeof(buffer), 0);
+    if (nRead <= 0)
+    {
+      close(fd);
+      return;
+    }
+    strRequest.append(buffer, nRead);
+  }
+
+  m_nRequests++;
+
+  // "GET <path> HTTP/1.0"
+  const std::string::size_type nPath = strRequest.find(' ');
+  const std::string::size_type nEnd = strRequest.find(' ', nPath + 1);
+  const std::string strPath = nPath != std::string::npos && nEnd != std::string::npos
+                                  ? strRequest.substr(nPath + 1, nEnd - nPath - 1)
+                                  : "";
+
+  int nCode = 200;
+  const std::string strBody = Respond(strPath, nCode);
+
+  char header[128];
+  snprintf(header, sizeof(header), "HTTP/1.0 %d %s\r\nContent-Length: %zu\r\n\r\n", nCode,
+           nCode == 200 ? "OK" : "Error", strBody.size());
+
+  const std::string strResponse = header + strBody;
+  size_t nSent = 0;
+  while (nSent < strResponse.size())
+  {
+    const ssize_t nWritten = send(fd, strResponse.data() + nSent, strResponse.size() - nSent, MSG_NOSIGNAL);
+    if (nWritten <= 0)
+      break;
+    nSent += nWritten;
+  }
+
+  close(fd);
+}
+
+std::string HttpFixture::Respond(const std::string& strPath, int& nCode)
+{
+  const unsigned int nGeneration = m_nGeneration;
+  int nDevice = 0;
+  char szName[64] = {};
+
+  if (sscanf(strPath.c_str(), "/api/guide.php?DeviceAuth=auth%d", &nDevice) == 1 &&
+      nDevice >= 1 && nDevice <= TunerCount)
+    return GetGuide(nDevice, nGeneration);
+
+  if (sscanf(strPath.c_str(), "/t%d/%63[^?]", &nDevice, szName) == 2 && nDevice >= 1 && nDevice <= TunerCount)
+  {
+    if (strcmp(szName, "lineup.json") == 0)
+      return GetLineUp(nDevice, nGeneration);
+
+    if (strncmp(szName, "auto/", 5) == 0)
+    {
+      // Tuner 1 is busy every third time, so the add-on has to fail over
+      if (nDevice == 1 && m_nRequests % 3 == 0)
+      {
+        nCode = 403;
+        return "";
+      }
+
+      std::string strStream(188 * 64, '\0');
+      for (size_t nPacket = 0; nPacket < strStream.size(); nPacket += 188)
+        strStream[nPacket] = 0x47;
+      return strStream;
+    }
+  }
+
+  if (strPath == "/s1/discover.json")
+  {
+    Json::Value json;
+    json["StorageID"] = "FIXTURE-STORAGE-1";
+    json["StorageURL"] = GetBaseURL("s", 1) + "/recorded_files.json";
+    json["FreeSpace"] = Json::UInt64(500) * 1024 * 1024 * 1024;
+    json["TotalSpace"] = Json::UInt64(2000) * 1024 * 1024 * 1024;
+    return Write(json);
+  }
+
+  if (strPath == "/s1/recorded_files.json")
+    return GetSeries(nGeneration);
+
+  int nSeries = 0;
+  if (sscanf(strPath.c_str(), "/s1/episodes?SeriesID=%d", &nSeries) == 1)
+    return GetEpisodes(nSeries);
+
+  nCode = 404;
+  return "";
+}
+
+std::string HttpFixture::GetLineUp(int nTuner, unsigned int nGeneration) const
+{
+  Json::Value json(Json::arrayValue);
+
+  for (int nIndex = 0; nIndex < ChannelCount; nIndex++)
+  {
+    const int nChannel = GetChannel(nTuner, nIndex);
+
+    // Odd generations lose a channel, the next one brings it back
+    if (nGeneration % 2 == 1 && nIndex == static_cast<int>(nGeneration / 2 % ChannelCount))
+      continue;
+
+    Json::Value jsonChannel;
+    jsonChannel["GuideNumber"] = GetGuideNumber(nChannel);
+    jsonChannel["GuideName"] = "CH" + std::to_string(nChannel);
+    jsonChannel["URL"] = GetBaseURL("t", nTuner) + "/auto/v" + GetGuideNumber(nChannel);
+    if (nChannel % 2 == 0)
+      jsonChannel["HD"] = 1;
+    if (nChannel % 10 == 0)
+      jsonChannel["Favorite"] = 1;
+    if (nChannel % 15 == 7)
+      jsonChannel["DRM"] = 1;
+
+    json.append(jsonChannel);
+  }
+
+  return Write(json);
+}
+
+std::string HttpFixture::GetGuide(int nTuner, unsigned int nGeneration) const
+{
+  static const char* const filters[] = {"News", "Comedy", "Movie", "Sports", "Kids", "Drama"};
+
+  Json::Value json(Json::arrayValue);
+  const int nSlots = GuideHours * 60 * 60 / SlotLength;
+
+  for (int nIndex = 0; nIndex < ChannelCount; nIndex++)
+  {
+    const int nChannel = GetChannel(nTuner, nIndex);
+    Json::Value jsonChannel;
+
+    jsonChannel["GuideNumber"] = GetGuideNumber(nChannel);
+    jsonChannel["GuideName"] = "CH" + std::to_string(nChannel);
+    jsonChannel["Affiliate"] = "Affiliate " + std::to_string(nChannel);
+    jsonChannel["ImageURL"] = "http://127.0.0.1/images/" + std::to_string(nChannel) + ".png";
+
+    Json::Value& jsonGuide = jsonChannel["Guide"];
+    jsonGuide = Json::Value(Json::arrayValue);
+
+    for (int nSlot = 0; nSlot < nSlots; nSlot++)
+    {
+      const time_t tStart = m_tStart + nSlot * SlotLength;
+      const int nShow = (nChannel + nSlot) % 25;
+      Json::Value jsonEntry;
+
+      jsonEntry["StartTime"] = Json::UInt64(tStart);
+      jsonEntry["EndTime"] = Json::UInt64(tStart + SlotLength);
+      jsonEntry["Title"] = "Show " + std::to_string(nShow);
+      jsonEntry["EpisodeTitle"] = "Episode " + std::to_string(nSlot) + " rev " + std::to_string(nGeneration);
+      jsonEntry["EpisodeNumber"] = "S01E" + std::to_string(nSlot % 20 + 1);
+      jsonEntry["Synopsis"] = "Synopsis of show " + std::to_string(nShow) + ", slot " + std::to_string(nSlot);
+      jsonEntry["ImageURL"] = "http://127.0.0.1/images/show" + std::to_string(nShow) + ".png";
+      jsonEntry["SeriesID"] = "SER" + std::to_string(nShow);
+      jsonEntry["OriginalAirdate"] = Json::UInt64(tStart - (nSlot % 3) * 24 * 60 * 60);
+      jsonEntry["Filter"].append(filters[nShow % 6]);
+
+      jsonGuide.append(jsonEntry);
+    }
+
+    json.append(jsonChannel);
+  }
+
+  return Write(json);
+}
+
+std::string HttpFixture::GetSeries(unsigned int nGeneration) const
+{
+  Json::Value json(Json::arrayValue);
+
+  for (int nSeries = 0; nSeries < SeriesCount; nSeries++)
+  {
+    Json::Value jsonSeries;
+    jsonSeries["SeriesID"] = "SER" + std::to_string(nSeries);
+    jsonSeries["Title"] = "Series " + std::to_string(nSeries);
+    jsonSeries["EpisodesURL"] = GetBaseURL("s", 1) + "/episodes?SeriesID=" + std::to_string(nSeries);
+    // One series gets a new recording per generation
+    jsonSeries["StartTime"] = Json::UInt64(m_tStart + (nSeries == static_cast<int>(nGeneration % SeriesCount) ? nGeneration : 0));
+
+    json.append(jsonSeries);
+  }
+
+  return Write(json);
+}
+
+std::string HttpFixture::GetEpisodes(int nSeries) const
+{
+  Json::Value json(Json::arrayValue);
+
+  for (int nEpisode = 0; nEpisode < EpisodesPerSeries; nEpisode++)
+  {
+    const time_t tStart = m_tStart - (nEpisode + 1) * 24 * 60 * 60;
+    const std::string strId = std::to_string(nSeries) + "-" + std::to_string(nEpisode);
+    Json::Value jsonEpisode;
+
+    jsonEpisode["PlayURL"] = GetBaseURL("s", 1) + "/play?id=" + strId;
+    jsonEpisode["Title"] = "Series " + std::to_string(nSeries);
+    jsonEpisode["EpisodeTitle"] = "Recorded episode " + strId;
+    jsonEpisode["EpisodeNumber"] = "S01E" + std::to_string(nEpisode + 1);
+    jsonEpisode["Synopsis"] = "Recording " + strId;
+    jsonEpisode["SeriesID"] = "SER" + std::to_string(nSeries);
+    jsonEpisode["RecordStartTime"] = Json::UInt64(tStart);
+    jsonEpisode["RecordEndTime"] = Json::UInt64(tStart + SlotLength);
+    jsonEpisode["OriginalAirdate"] = Json::UInt64(tStart);
+    jsonEpisode["Category"] = "series";
+    jsonEpisode["ChannelName"] = "CH" + std::to_string(nSeries);
+
+    json.append(jsonEpisode);
+  }
+
+  return Write(json);
+}
+
+//
+// libhdhomerun stand-in: discovery reports the fixture's devices
+//
+int hdhomerun_discover_find_devices_custom_v2(uint32_t target_ip, uint32_t device_type, uint32_t device_id,
+                                              struct hdhomerun_discover_device_t result_list[], int max_count)
+{
+  // HTTP discovery asks for single addresses, the fixture is only found by broadcast
+  if (target_ip != 0)
+    return 0;
+
+  const bool bStorage = device_type == HDHOMERUN_DEVICE_TYPE_STORAGE;
+  const int nCount = std::min(bStorage ? 1 : HttpFixture::TunerCount, max_count);
+
+  for (int nDevice = 1; nDevice <= nCount; nDevice++)
+  {
+    hdhomerun_discover_device_t& device = result_list[nDevice - 1];
+
+    device = {};
+    device.ip_addr = 0x7F000001 + nDevice + (bStorage ? 100 : 0);
+    device.device_type = device_type;
+    device.device_id = bStorage ? 0 : FirstDeviceID + nDevice - 1;
+    device.tuner_count = bStorage ? 0 : 2;
+    snprintf(device.device_auth, sizeof(device.device_auth), "auth%d", nDevice);
+    snprintf(device.base_url, sizeof(device.base_url), "%s", GetBaseURL(bStorage ? "s" : "t", nDevice).c_str());
+  }
+
+  return nCount;
+}
+
+struct hdhomerun_device_t* hdhomerun_device_create(uint32_t device_id, uint32_t device_ip,
+                                                   unsigned int tuner, struct hdhomerun_debug_t* dbg)
+{
+  // Feature queries are not part of the fixture
+  return nullptr;
+}
+
+void hdhomerun_device_destroy(struct hdhomerun_device_t* hd)
+{
+}
+
+int hdhomerun_device_get_var(struct hdhomerun_device_t* hd, const char* name, char** pvalue, char** perror)
+{
+  return -1;
+}
@@ -0,0 +1,64 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2015 Zoltan Csizmadia (zcsizmadia@gmail.com)
+ *  Copyright (C) 2011 Pulse-Eight (https://www.pulse-eight.com)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Local stand-in for the HDHomeRun devices and the guide service: two tuners
+// sharing most of their lineup and a record engine, served over HTTP/1.0.
+// The content changes with every generation so each refresh publishes new state.
+class HttpFixture
+{
+public:
+  static constexpr int TunerCount = 2;
+  static constexpr int ChannelCount = 60;
+  static constexpr int GuideHours = 24;
+  static constexpr int SeriesCount = 40;
+  static constexpr int EpisodesPerSeries = 10;
+
+  // Returns the port listened on, 0 on failure
+  int Start();
+  void Stop();
+
+  void NextGeneration() { m_nGeneration++; }
+  unsigned int GetRequestCount() const { return m_nRequests; }
+
+private:
+  static constexpr int WorkerCount = 8;
+
+  void Accept();
+  void Work();
+  void Handle(int fd);
+  std::string Respond(const std::string& strPath, int& nCode);
+
+  std::string GetLineUp(int nTuner, unsigned int nGeneration) const;
+  std::string GetGuide(int nTuner, unsigned int nGeneration) const;
+  std::string GetSeries(unsigned int nGeneration) const;
+  std::string GetEpisodes(int nSeries) const;
+
+  int m_nListen = -1;
+  int m_nPort = 0;
+  time_t m_tStart = 0;
+  std::atomic<unsigned int> m_nGeneration = {0};
+  std::atomic<unsigned int> m_nRequests = {0};
+  std::atomic<bool> m_running = {false};
+
+  std::thread m_AcceptThread;
+  std::vector<std::thread> m_Workers;
+  std::mutex m_mutex;
+  std::condition_variable m_condition;
+  std::deque<int> m_Connections;
+};
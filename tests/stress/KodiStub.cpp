@@ -0,0 +1,338 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2015 Zoltan Csizmadia (zcsizmadia@gmail.com)
+ *  Copyright (C) 2011 Pulse-Eight (https://www.pulse-eight.com)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "KodiStub.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include <fcntl.h>
+#include <kodi/Filesystem.h>
+#include <kodi/General.h>
+#include <kodi/tools/StringUtils.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+namespace
+{
+
+std::mutex g_mutex;
+std::string g_strUserPath;
+std::map<std::string, std::string> g_settings;
+std::atomic<int> g_nFixturePort = {0};
+std::atomic<bool> g_bShowDebugLog = {false};
+
+bool GetSetting(const std::string& strName, std::string& strValue)
+{
+  std::lock_guard<std::mutex> lock(g_mutex);
+
+  const auto iter = g_settings.find(strName);
+  if (iter == g_settings.end())
+    return false;
+
+  strValue = iter->second;
+  return true;
+}
+
+} // unnamed namespace
+
+namespace stress
+{
+
+void SetUserPath(const std::string& strPath)
+{
+  std::lock_guard<std::mutex> lock(g_mutex);
+  g_strUserPath = strPath;
+}
+
+void SetFixturePort(int nPort)
+{
+  g_nFixturePort = nPort;
+}
+
+int GetFixturePort()
+{
+  return g_nFixturePort;
+}
+
+void SetSetting(const std::string& strName, const std::string& strValue)
+{
+  std::lock_guard<std::mutex> lock(g_mutex);
+  g_settings[strName] = strValue;
+}
+
+void SetShowDebugLog(bool bShow)
+{
+  g_bShowDebugLog = bShow;
+}
+
+} // namespace stress
+
+//
+// General
+//
+void kodi::Log(const ADDON_LOG loglevel, const char* format, ...)
+{
+  static const char* const levels[] = {"DEBUG", "INFO", "WARNING", "ERROR", "FATAL"};
+
+  if (loglevel == ADDON_LOG_DEBUG && !g_bShowDebugLog)
+    return;
+
+  char buffer[4096];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+
+  std::lock_guard<std::mutex> lock(g_mutex);
+  fprintf(stdout, "%-7s %s\n", levels[loglevel], buffer);
+}
+
+std::string kodi::tools::StringUtils::Format(const char* fmt, ...)
+{
+  va_list args;
+  va_start(args, fmt);
+  const int nLength = vsnprintf(nullptr, 0, fmt, args);
+  va_end(args);
+
+  if (nLength <= 0)
+    return "";
+
+  std::vector<char> buffer(nLength + 1);
+  va_start(args, fmt);
+  vsnprintf(buffer.data(), buffer.size(), fmt, args);
+  va_end(args);
+
+  return std::string(buffer.data(), nLength);
+}
+
+//
+// Settings
+//
+bool kodi::addon::GetSettingBoolean(const std::string& settingName, bool defaultValue)
+{
+  std::string strValue;
+  return GetSetting(settingName, strValue) ? strValue == "true" : defaultValue;
+}
+
+int kodi::addon::GetSettingInt(const std::string& settingName, int defaultValue)
+{
+  std::string strValue;
+  return GetSetting(settingName, strValue) ? std::stoi(strValue) : defaultValue;
+}
+
+std::string kodi::addon::GetSettingString(const std::string& settingName, const std::string& defaultValue)
+{
+  std::string strValue;
+  return GetSetting(settingName, strValue) ? strValue : defaultValue;
+}
+
+std::string kodi::addon::GetUserPath(const std::string& append)
+{
+  std::lock_guard<std::mutex> lock(g_mutex);
+  return g_strUserPath + "/" + append;
+}
+
+//
+// Filesystem
+//
+bool kodi::vfs::FileExists(const std::string& filename, bool usecache)
+{
+  struct stat st;
+  return stat(filename.c_str(), &st) == 0 && S_ISREG(st.st_mode);
+}
+
+bool kodi::vfs::DirectoryExists(const std::string& path)
+{
+  struct stat st;
+  return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+bool kodi::vfs::CreateDirectory(const std::string& path)
+{
+  return mkdir(path.c_str(), 0755) == 0;
+}
+
+bool kodi::vfs::RenameFile(const std::string& filename, const std::string& newFileName)
+{
+  return rename(filename.c_str(), newFileName.c_str()) == 0;
+}
+
+bool kodi::vfs::CFile::OpenFile(const std::string& filename, unsigned int flags)
+{
+  Close();
+  m_fd = open(filename.c_str(), O_RDONLY);
+  return m_fd >= 0;
+}
+
+bool kodi::vfs::CFile::OpenFileForWrite(const std::string& filename, bool overwrite)
+{
+  Close();
+  m_fd = open(filename.c_str(), O_RDWR | O_CREAT | (overwrite ? O_TRUNC : 0), 0644);
+  return m_fd >= 0;
+}
+
+void kodi::vfs::CFile::Close()
+{
+  if (m_fd >= 0)
+    close(m_fd);
+
+  m_fd = -1;
+  m_bSocket = false;
+  m_strProtocol.clear();
+  m_strPending.clear();
+  m_nContentLength = -1;
+}
+
+bool kodi::vfs::CFile::CURLCreate(const std::string& url)
+{
+  Close();
+  m_strUrl = url;
+  m_bFailOnError = true;
+  return true;
+}
+
+bool kodi::vfs::CFile::CURLAddOption(CURLOptiontype type, const std::string& name, const std::string& value)
+{
+  if (type == ADDON_CURL_OPTION_PROTOCOL && name == "failonerror")
+    m_bFailOnError = value != "false";
+
+  return true;
+}
+
+bool kodi::vfs::CFile::CURLOpen(unsigned int flags)
+{
+  // scheme://host[:port]/path, only the path is sent, to the fixture
+  const std::string::size_type nHost = m_strUrl.find("://");
+  if (nHost == std::string::npos)
+    return false;
+
+  const std::string::size_type nPath = m_strUrl.find('/', nHost + 3);
+  const std::string strHost = m_strUrl.substr(nHost + 3, nPath - (nHost + 3));
+  const std::string strPath = nPath != std::string::npos ? m_strUrl.substr(nPath) : "/";
+
+  m_fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (m_fd < 0)
+    return false;
+  m_bSocket = true;
+
+  struct timeval timeout = {10, 0};
+  setsockopt(m_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(static_cast<uint16_t>(stress::GetFixturePort()));
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  const std::string strRequest = "GET " + strPath + " HTTP/1.0\r\nHost: " + strHost + "\r\n\r\n";
+
+  if (connect(m_fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0 ||
+      send(m_fd, strRequest.c_str(), strRequest.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(strRequest.size()))
+  {
+    Close();
+    return false;
+  }
+
+  // Headers, whatever follows them is the start of the body
+  std::string strResponse;
+  std::string::size_type nBody;
+  char buffer[4096];
+
+  while ((nBody = strResponse.find("\r\n\r\n")) == std::string::npos)
+  {
+    const ssize_t nRead = recv(m_fd, buffer, sizeof(buffer), 0);
+    if (nRead <= 0)
+    {
+      Close();
+      return false;
+    }
+    strResponse.append(buffer, nRead);
+  }
+
+  m_strProtocol = strResponse.substr(0, strResponse.find("\r\n"));
+  m_strPending = strResponse.substr(nBody + 4);
+
+  const std::string::size_type nLength = strResponse.find("Content-Length: ");
+  if (nLength != std::string::npos && nLength < nBody)
+    m_nContentLength = std::stoll(strResponse.substr(nLength + 16));
+
+  const std::string::size_type nCode = m_strProtocol.find(' ');
+  const int nResponseCode = nCode != std::string::npos ? atoi(m_strProtocol.c_str() + nCode + 1) : -1;
+
+  if (m_bFailOnError && nResponseCode >= 400)
+  {
+    Close();
+    return false;
+  }
+
+  return true;
+}
+
+ssize_t kodi::vfs::CFile::Read(void* ptr, size_t size)
+{
+  if (m_fd < 0)
+    return -1;
+
+  if (!m_bSocket)
+    return read(m_fd, ptr, size);
+
+  if (!m_strPending.empty())
+  {
+    const size_t nLength = std::min(size, m_strPending.size());
+    memcpy(ptr, m_strPending.data(), nLength);
+    m_strPending.erase(0, nLength);
+    return nLength;
+  }
+
+  return recv(m_fd, ptr, size, 0);
+}
+
+ssize_t kodi::vfs::CFile::Write(const void* ptr, size_t size)
+{
+  return m_fd >= 0 && !m_bSocket ? write(m_fd, ptr, size) : -1;
+}
+
+void kodi::vfs::CFile::Flush()
+{
+  if (m_fd >= 0 && !m_bSocket)
+    fsync(m_fd);
+}
+
+int64_t kodi::vfs::CFile::Seek(int64_t position, int whence)
+{
+  return m_fd >= 0 && !m_bSocket ? lseek(m_fd, position, whence) : -1;
+}
+
+int kodi::vfs::CFile::Truncate(int64_t size)
+{
+  return m_fd >= 0 && !m_bSocket ? ftruncate(m_fd, size) : -1;
+}
+
+int64_t kodi::vfs::CFile::GetLength() const
+{
+  if (m_bSocket)
+    return m_nContentLength;
+
+  struct stat st;
+  return m_fd >= 0 && fstat(m_fd, &st) == 0 ? st.st_size : -1;
+}
+
+std::string kodi::vfs::CFile::GetPropertyValue(FilePropertyTypes type, const std::string& name) const
+{
+  return type == ADDON_FILE_PROPERTY_RESPONSE_PROTOCOL ? m_strProtocol : "";
+}
@@ -0,0 +1,31 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2015 Zoltan Csizmadia (zcsizmadia@gmail.com)
+ *  Copyright (C) 2011 Pulse-Eight (https://www.pulse-eight.com)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <string>
+
+// Controls for the stubbed Kodi runtime the stress test runs the add-on in
+namespace stress
+{
+
+// Directory returned by kodi::addon::GetUserPath()
+void SetUserPath(const std::string& strPath);
+
+// Every CURL request goes to the HTTP fixture on this local port
+void SetFixturePort(int nPort);
+int GetFixturePort();
+
+// Values returned by kodi::addon::GetSetting*(), unset settings use the default
+void SetSetting(const std::string& strName, const std::string& strValue);
+
+// Debug messages are dropped unless enabled, the add-on logs every request
+void SetShowDebugLog(bool bShow);
+
+} // namespace stress
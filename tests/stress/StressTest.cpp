@@ -0,0 +1,244 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2015 Zoltan Csizmadia (zcsizmadia@gmail.com)
+ *  Copyright (C) 2011 Pulse-Eight (https://www.pulse-eight.com)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+// Drives the add-on's API from several threads while Update() refreshes the
+// lineups, guides and recordings from the local HTTP fixture, then reports the
+// add-on's latency and lock contention stats. Build it with ThreadSanitizer
+// (the default for this target) to catch data races in the locking.
+//
+// Usage: pvr.hdhomerun-stress [seconds] [threads]
+
+#include "HttpFixture.h"
+#include "KodiStub.h"
+
+#include "../../src/HDHomeRunTuners.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <json/json.h>
+#include <kodi/Filesystem.h>
+
+namespace
+{
+
+// Exposes the stats report to the harness
+class StressTuners : public HDHomeRunTuners
+{
+public:
+  using HDHomeRunTuners::LogStats;
+};
+
+struct Counters
+{
+  std::atomic<unsigned int> Calls = {0};
+  std::atomic<unsigned int> Failures = {0};
+  std::atomic<unsigned int> StreamProbes = {0};
+  std::atomic<unsigned int> StreamFailures = {0};
+  std::atomic<unsigned int> Updates = {0};
+};
+
+void Fail(Counters& counters, const char* szWhat)
+{
+  if (counters.Failures++ < 10)
+    fprintf(stderr, "FAILED: %s\n", szWhat);
+}
+
+// One client thread, calling the API the way Kodi's PVR manager and GUI do
+void Client(StressTuners& tuners, Counters& counters, unsigned int nSeed,
+            std::chrono::steady_clock::time_point deadline)
+{
+  std::mt19937 random(nSeed);
+
+  for (unsigned int nIteration = 0; std::chrono::steady_clock::now() < deadline; nIteration++)
+  {
+    kodi::addon::PVRChannelsResultSet channels;
+    if (tuners.GetChannels(false, channels) != PVR_ERROR_NO_ERROR || channels.GetItems().empty())
+    {
+      Fail(counters, "GetChannels returned no channels");
+      continue;
+    }
+
+    const auto& items = channels.GetItems();
+    const kodi::addon::PVRChannel& channel = items[random() % items.size()];
+
+    // The EPG for the next hours must be sorted and free of overlaps
+    const time_t now = time(nullptr);
+    kodi::addon::PVREPGTagsResultSet tags;
+    tuners.GetEPGForChannel(channel.GetUniqueId(), now, now + 6 * 60 * 60, tags);
+
+    // Every fixture channel has a guide, found through the device's guide number index
+    if (tags.GetItems().empty())
+      Fail(counters, "GetEPGForChannel returned no entries");
+
+    time_t tLastEnd = 0;
+    for (const auto& tag : tags.GetItems())
+    {
+      if (tag.GetStartTime() >= tag.GetEndTime() || tag.GetStartTime() < tLastEnd)
+        Fail(counters, "GetEPGForChannel returned unsorted or overlapping entries");
+      tLastEnd = tag.GetEndTime();
+    }
+
+    kodi::addon::PVRChannelGroupsResultSet groups;
+    tuners.GetChannelGroups(false, groups);
+    for (const auto& group : groups.GetItems())
+    {
+      kodi::addon::PVRChannelGroupMembersResultSet members;
+      tuners.GetChannelGroupMembers(group, members);
+    }
+
+    kodi::addon::PVRRecordingsResultSet recordings;
+    tuners.GetRecordings(false, recordings);
+
+    // Recording IDs do not carry the engine's address, its play URL does
+    if (!recordings.GetItems().empty())
+    {
+      const auto& recording = recordings.GetItems()[random() % recordings.GetItems().size()];
+      std::vector<kodi::addon::PVRStreamProperty> properties;
+
+      if (recording.GetRecordingId().compare(0, 18, "FIXTURE-STORAGE-1/") != 0)
+        Fail(counters, "GetRecordings returned an ID without the StorageID");
+      else if (tuners.GetRecordingStreamProperties(recording, properties) != PVR_ERROR_NO_ERROR ||
+               properties.empty() || properties.front().GetValue().find("/s1/play?id=") == std::string::npos)
+        Fail(counters, "GetRecordingStreamProperties did not return the play URL");
+    }
+
+    // Stream probes go to the fixture, do them less often than the cached calls
+    if (nIteration % 8 == 0)
+    {
+      std::vector<kodi::addon::PVRStreamProperty> properties;
+      tuners.GetChannelStreamProperties(channel, PVR_SOURCE_DEFAULT, properties);
+
+      counters.StreamProbes++;
+      if (properties.empty())
+        counters.StreamFailures++;
+    }
+
+    counters.Calls++;
+  }
+}
+
+// The refresh thread: a new fixture generation, then a full refresh, and now and
+// then a filter setting change, which rebuilds the channels on the caller's thread
+void Refresh(StressTuners& tuners, HttpFixture& fixture, Counters& counters,
+             std::chrono::steady_clock::time_point deadline)
+{
+  for (unsigned int nPass = 0; std::chrono::steady_clock::now() < deadline; nPass++)
+  {
+    fixture.NextGeneration();
+
+    if (!tuners.Update())
+      Fail(counters, "Update found no devices");
+    tuners.UpdateRecordEngines();
+
+    int nRecordings = 0;
+    tuners.GetRecordingsAmount(false, nRecordings);
+    if (nRecordings != HttpFixture::SeriesCount * HttpFixture::EpisodesPerSeries)
+      Fail(counters, "GetRecordingsAmount does not match the fixture's recordings");
+
+    if (nPass % 4 == 3)
+      tuners.SetSetting("hide_duplicate", kodi::addon::CSettingValue(nPass % 8 == 3 ? "false" : "true"));
+
+    counters.Updates++;
+  }
+}
+
+} // unnamed namespace
+
+int main(int argc, char* argv[])
+{
+  const int nSeconds = argc > 1 ? atoi(argv[1]) : 10;
+  const int nThreads = argc > 2 ? atoi(argv[2]) : 4;
+
+  char szUserPath[] = "/tmp/pvr.hdhomerun-stress-XXXXXX";
+  if (!mkdtemp(szUserPath))
+  {
+    fprintf(stderr, "Unable to create a user directory\n");
+    return 1;
+  }
+  stress::SetUserPath(szUserPath);
+
+  // The add-on only passes debug messages on when its debug setting is on
+  stress::SetSetting("debug", "true");
+
+  HttpFixture fixture;
+  const int nPort = fixture.Start();
+  if (nPort == 0)
+  {
+    fprintf(stderr, "Unable to start the HTTP fixture\n");
+    return 1;
+  }
+  stress::SetFixturePort(nPort);
+
+  Counters counters;
+
+  {
+    StressTuners tuners;
+    if (tuners.Create() != ADDON_STATUS_OK)
+    {
+      fprintf(stderr, "Create() failed\n");
+      return 1;
+    }
+
+    // Start from the stats of the run alone
+    tuners.LogStats();
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(nSeconds);
+    std::vector<std::thread> threads;
+
+    for (int nThread = 0; nThread < nThreads; nThread++)
+      threads.emplace_back(Client, std::ref(tuners), std::ref(counters), 1234 + nThread, deadline);
+    threads.emplace_back(Refresh, std::ref(tuners), std::ref(fixture), std::ref(counters), deadline);
+
+    for (auto& thread : threads)
+      thread.join();
+
+    printf("%d client threads, %d s: %u client iterations, %u refreshes, %u HTTP requests\n", nThreads,
+           nSeconds, counters.Calls.load(), counters.Updates.load(), fixture.GetRequestCount());
+    printf("Stream probes: %u, without a stream URL: %u\n", counters.StreamProbes.load(),
+           counters.StreamFailures.load());
+
+    stress::SetShowDebugLog(true);
+    tuners.LogStats();
+    stress::SetShowDebugLog(false);
+  }
+
+  fixture.Stop();
+
+  // Channel IDs are saved outside the lock, through a temporary file
+  {
+    const std::string strFile = std::string(szUserPath) + "/channelids.json";
+    std::ifstream file(strFile);
+    Json::Value jsonIds;
+
+    if (!file || !Json::parseFromStream(Json::CharReaderBuilder(), file, &jsonIds, nullptr) ||
+        !jsonIds.isObject() || jsonIds.size() < static_cast<unsigned int>(HttpFixture::ChannelCount))
+      Fail(counters, "channelids.json is missing or incomplete");
+    if (kodi::vfs::FileExists(strFile + ".tmp"))
+      Fail(counters, "channelids.json.tmp was left behind");
+  }
+
+  const std::string strCleanup = std::string("rm -rf ") + szUserPath;
+  if (system(strCleanup.c_str()) != 0)
+    fprintf(stderr, "Unable to remove %s\n", szUserPath);
+
+  if (counters.Failures > 0)
+  {
+    printf("%u checks failed\n", counters.Failures.load());
+    return 1;
+  }
+
+  return 0;
+}
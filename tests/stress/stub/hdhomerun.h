@@ -0,0 +1,45 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2015 Zoltan Csizmadia (zcsizmadia@gmail.com)
+ *  Copyright (C) 2011 Pulse-Eight (https://www.pulse-eight.com)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+// Stand-in for libhdhomerun; discovery reports the harness' fixture devices
+
+#include <arpa/inet.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define HDHOMERUN_DEVICE_TYPE_WILDCARD 0xFFFFFFFF
+#define HDHOMERUN_DEVICE_TYPE_TUNER 0x00000001
+#define HDHOMERUN_DEVICE_TYPE_STORAGE 0x00000005
+#define HDHOMERUN_DEVICE_ID_WILDCARD 0xFFFFFFFF
+
+struct hdhomerun_discover_device_t
+{
+  uint32_t ip_addr;
+  uint32_t device_type;
+  uint32_t device_id;
+  uint8_t tuner_count;
+  bool is_legacy;
+  char device_auth[25];
+  char base_url[29];
+};
+
+struct hdhomerun_device_t;
+struct hdhomerun_debug_t;
+
+extern "C"
+{
+int hdhomerun_discover_find_devices_custom_v2(uint32_t target_ip, uint32_t device_type, uint32_t device_id,
+                                              struct hdhomerun_discover_device_t result_list[], int max_count);
+struct hdhomerun_device_t* hdhomerun_device_create(uint32_t device_id, uint32_t device_ip,
+                                                   unsigned int tuner, struct hdhomerun_debug_t* dbg);
+void hdhomerun_device_destroy(struct hdhomerun_device_t* hd);
+int hdhomerun_device_get_var(struct hdhomerun_device_t* hd, const char* name, char** pvalue, char** perror);
+}
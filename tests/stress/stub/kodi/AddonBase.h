@@ -0,0 +1,85 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2015 Zoltan Csizmadia (zcsizmadia@gmail.com)
+ *  Copyright (C) 2011 Pulse-Eight (https://www.pulse-eight.com)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+// Minimal stand-in for Kodi's add-on API, just enough to build and drive the
+// add-on outside Kodi. The functions are implemented in KodiStub.cpp.
+
+#include <cstdarg>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define ATTR_DLL_LOCAL
+
+typedef enum
+{
+  ADDON_STATUS_OK,
+  ADDON_STATUS_LOST_CONNECTION,
+  ADDON_STATUS_NEED_RESTART,
+  ADDON_STATUS_NEED_SETTINGS,
+  ADDON_STATUS_UNKNOWN,
+  ADDON_STATUS_PERMANENT_FAILURE
+} ADDON_STATUS;
+
+typedef enum
+{
+  ADDON_LOG_DEBUG = 0,
+  ADDON_LOG_INFO = 1,
+  ADDON_LOG_WARNING = 2,
+  ADDON_LOG_ERROR = 3,
+  ADDON_LOG_FATAL = 4
+} ADDON_LOG;
+
+namespace kodi
+{
+
+void Log(const ADDON_LOG loglevel, const char* format, ...);
+
+namespace addon
+{
+
+class CSettingValue
+{
+public:
+  explicit CSettingValue(const std::string& strValue) : m_strValue(strValue) {}
+
+  bool GetBoolean() const { return m_strValue == "true"; }
+  int GetInt() const { return std::stoi(m_strValue); }
+  std::string GetString() const { return m_strValue; }
+
+private:
+  std::string m_strValue;
+};
+
+bool GetSettingBoolean(const std::string& settingName, bool defaultValue = false);
+int GetSettingInt(const std::string& settingName, int defaultValue = 0);
+std::string GetSettingString(const std::string& settingName, const std::string& defaultValue = "");
+std::string GetUserPath(const std::string& append = "");
+
+class CAddonBase
+{
+public:
+  virtual ~CAddonBase() = default;
+
+  virtual ADDON_STATUS Create() { return ADDON_STATUS_OK; }
+  virtual ADDON_STATUS SetSetting(const std::string& settingName, const CSettingValue& settingValue)
+  {
+    return ADDON_STATUS_OK;
+  }
+};
+
+} // namespace addon
+} // namespace kodi
+
+// The harness creates the add-on itself
+#define ADDONCREATOR(AddonClass)
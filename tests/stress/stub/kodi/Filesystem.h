@@ -0,0 +1,86 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2015 Zoltan Csizmadia (zcsizmadia@gmail.com)
+ *  Copyright (C) 2011 Pulse-Eight (https://www.pulse-eight.com)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include "AddonBase.h"
+
+#include <cstdio>
+#include <sys/types.h>
+
+typedef enum
+{
+  ADDON_CURL_OPTION_CONTEXT,
+  ADDON_CURL_OPTION_HEADER,
+  ADDON_CURL_OPTION_PROTOCOL,
+  ADDON_CURL_OPTION_CREDENTIALS,
+  ADDON_CURL_OPTION_OPTION
+} CURLOptiontype;
+
+typedef enum
+{
+  ADDON_FILE_PROPERTY_RESPONSE_PROTOCOL,
+  ADDON_FILE_PROPERTY_RESPONSE_HEADER,
+  ADDON_FILE_PROPERTY_CONTENT_TYPE,
+  ADDON_FILE_PROPERTY_CONTENT_CHARSET,
+  ADDON_FILE_PROPERTY_MIME_TYPE,
+  ADDON_FILE_PROPERTY_EFFECTIVE_URL
+} FilePropertyTypes;
+
+#define ADDON_READ_TRUNCATED 0x01
+#define ADDON_READ_CHUNKED 0x02
+#define ADDON_READ_CACHED 0x04
+#define ADDON_READ_NO_CACHE 0x08
+
+namespace kodi
+{
+namespace vfs
+{
+
+bool FileExists(const std::string& filename, bool usecache = false);
+bool DirectoryExists(const std::string& path);
+bool CreateDirectory(const std::string& path);
+bool RenameFile(const std::string& filename, const std::string& newFileName);
+
+// Local files map to plain files; CURL requests are plain HTTP/1.0 requests to
+// the harness' HTTP fixture, whatever host the URL names
+class CFile
+{
+public:
+  CFile() = default;
+  ~CFile() { Close(); }
+
+  bool OpenFile(const std::string& filename, unsigned int flags = 0);
+  bool OpenFileForWrite(const std::string& filename, bool overwrite = false);
+  void Close();
+
+  bool CURLCreate(const std::string& url);
+  bool CURLAddOption(CURLOptiontype type, const std::string& name, const std::string& value);
+  bool CURLOpen(unsigned int flags = 0);
+
+  ssize_t Read(void* ptr, size_t size);
+  ssize_t Write(const void* ptr, size_t size);
+  void Flush();
+  int64_t Seek(int64_t position, int whence = SEEK_SET);
+  int Truncate(int64_t size);
+  int64_t GetLength() const;
+  std::string GetPropertyValue(FilePropertyTypes type, const std::string& name) const;
+
+private:
+  int m_fd = -1;
+  bool m_bSocket = false;
+  bool m_bFailOnError = true;
+  std::string m_strUrl;
+  std::string m_strProtocol;
+  std::string m_strPending;
+  int64_t m_nContentLength = -1;
+};
+
+} // namespace vfs
+} // namespace kodi
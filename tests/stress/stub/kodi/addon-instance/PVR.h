@@ -0,0 +1,240 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2015 Zoltan Csizmadia (zcsizmadia@gmail.com)
+ *  Copyright (C) 2011 Pulse-Eight (https://www.pulse-eight.com)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include "../AddonBase.h"
+
+#include <atomic>
+
+typedef enum
+{
+  PVR_ERROR_NO_ERROR = 0,
+  PVR_ERROR_UNKNOWN = -1,
+  PVR_ERROR_NOT_IMPLEMENTED = -2,
+  PVR_ERROR_SERVER_ERROR = -3,
+  PVR_ERROR_SERVER_TIMEOUT = -4,
+  PVR_ERROR_REJECTED = -5,
+  PVR_ERROR_ALREADY_PRESENT = -6,
+  PVR_ERROR_INVALID_PARAMETERS = -7,
+  PVR_ERROR_RECORDING_RUNNING = -8,
+  PVR_ERROR_FAILED = -9
+} PVR_ERROR;
+
+typedef enum
+{
+  PVR_SOURCE_DEFAULT = 0
+} PVR_SOURCE;
+
+typedef enum
+{
+  PVR_RECORDING_CHANNEL_TYPE_UNKNOWN = 0,
+  PVR_RECORDING_CHANNEL_TYPE_TV = 1,
+  PVR_RECORDING_CHANNEL_TYPE_RADIO = 2
+} PVR_RECORDING_CHANNEL_TYPE;
+
+#define PVR_STREAM_PROPERTY_STREAMURL "streamurl"
+#define PVR_STREAM_PROPERTY_ISREALTIMESTREAM "isrealtimestream"
+#define PVR_STREAM_PROPERTY_MIMETYPE "mimetype"
+
+#define EPG_TAG_INVALID_SERIES_EPISODE -1
+
+#define EPG_EVENT_CONTENTMASK_MOVIEDRAMA 0x10
+#define EPG_EVENT_CONTENTMASK_NEWSCURRENTAFFAIRS 0x20
+#define EPG_EVENT_CONTENTMASK_SHOW 0x30
+#define EPG_EVENT_CONTENTMASK_SPORTS 0x40
+#define EPG_EVENT_CONTENTMASK_CHILDRENYOUTH 0x50
+#define EPG_EVENT_CONTENTMASK_LEISUREHOBBIES 0xA0
+
+#define STREAM_TIME_BASE 1000000
+
+// Plain value holders; the add-on copies its data into them like it does into Kodi's
+#define STUB_PROPERTY(Type, Name) \
+public: \
+  void Set##Name(const Type& value) { m_##Name = value; } \
+  Type Get##Name() const { return m_##Name; } \
+\
+private: \
+  Type m_##Name{};
+
+namespace kodi
+{
+namespace addon
+{
+
+class PVRCapabilities
+{
+  STUB_PROPERTY(bool, SupportsEPG)
+  STUB_PROPERTY(bool, SupportsTV)
+  STUB_PROPERTY(bool, SupportsRadio)
+  STUB_PROPERTY(bool, SupportsChannelGroups)
+  STUB_PROPERTY(bool, SupportsRecordings)
+  STUB_PROPERTY(bool, SupportsRecordingsDelete)
+  STUB_PROPERTY(bool, SupportsRecordingsUndelete)
+  STUB_PROPERTY(bool, SupportsRecordingsRename)
+  STUB_PROPERTY(bool, SupportsRecordingsLifetimeChange)
+  STUB_PROPERTY(bool, SupportsTimers)
+  STUB_PROPERTY(bool, SupportsDescrambleInfo)
+  STUB_PROPERTY(bool, HandlesInputStream)
+};
+
+class PVRChannel
+{
+  STUB_PROPERTY(unsigned int, UniqueId)
+  STUB_PROPERTY(bool, IsRadio)
+  STUB_PROPERTY(unsigned int, ChannelNumber)
+  STUB_PROPERTY(unsigned int, SubChannelNumber)
+  STUB_PROPERTY(std::string, ChannelName)
+  STUB_PROPERTY(std::string, IconPath)
+  STUB_PROPERTY(bool, IsHidden)
+};
+
+class PVRChannelGroup
+{
+  STUB_PROPERTY(std::string, GroupName)
+  STUB_PROPERTY(bool, IsRadio)
+  STUB_PROPERTY(unsigned int, Position)
+};
+
+class PVRChannelGroupMember
+{
+  STUB_PROPERTY(std::string, GroupName)
+  STUB_PROPERTY(unsigned int, ChannelUniqueId)
+  STUB_PROPERTY(unsigned int, ChannelNumber)
+  STUB_PROPERTY(unsigned int, SubChannelNumber)
+};
+
+class PVREPGTag
+{
+  STUB_PROPERTY(unsigned int, UniqueBroadcastId)
+  STUB_PROPERTY(unsigned int, UniqueChannelId)
+  STUB_PROPERTY(std::string, Title)
+  STUB_PROPERTY(time_t, StartTime)
+  STUB_PROPERTY(time_t, EndTime)
+  STUB_PROPERTY(std::string, Plot)
+  STUB_PROPERTY(std::string, IconPath)
+  STUB_PROPERTY(int, GenreType)
+  STUB_PROPERTY(std::string, FirstAired)
+  STUB_PROPERTY(int, SeriesNumber)
+  STUB_PROPERTY(int, EpisodeNumber)
+  STUB_PROPERTY(int, EpisodePartNumber)
+  STUB_PROPERTY(std::string, EpisodeName)
+  STUB_PROPERTY(std::string, SeriesLink)
+};
+
+class PVRRecording
+{
+  STUB_PROPERTY(std::string, RecordingId)
+  STUB_PROPERTY(std::string, Title)
+  STUB_PROPERTY(std::string, EpisodeName)
+  STUB_PROPERTY(int, SeriesNumber)
+  STUB_PROPERTY(int, EpisodeNumber)
+  STUB_PROPERTY(std::string, Directory)
+  STUB_PROPERTY(std::string, Plot)
+  STUB_PROPERTY(std::string, ChannelName)
+  STUB_PROPERTY(std::string, IconPath)
+  STUB_PROPERTY(std::string, ThumbnailPath)
+  STUB_PROPERTY(time_t, RecordingTime)
+  STUB_PROPERTY(int, Duration)
+  STUB_PROPERTY(int, GenreType)
+  STUB_PROPERTY(std::string, FirstAired)
+  STUB_PROPERTY(PVR_RECORDING_CHANNEL_TYPE, ChannelType)
+  STUB_PROPERTY(std::string, SeriesLink)
+};
+
+class PVRSignalStatus
+{
+  STUB_PROPERTY(std::string, AdapterName)
+  STUB_PROPERTY(std::string, AdapterStatus)
+};
+
+class PVRStreamTimes
+{
+  STUB_PROPERTY(time_t, StartTime)
+  STUB_PROPERTY(int64_t, PTSStart)
+  STUB_PROPERTY(int64_t, PTSBegin)
+  STUB_PROPERTY(int64_t, PTSEnd)
+};
+
+class PVRStreamProperty
+{
+public:
+  PVRStreamProperty(const std::string& name, const std::string& value) : m_name(name), m_value(value) {}
+
+  std::string GetName() const { return m_name; }
+  std::string GetValue() const { return m_value; }
+
+private:
+  std::string m_name;
+  std::string m_value;
+};
+
+template<class T>
+class StubResultSet
+{
+public:
+  void Add(const T& item) { m_items.push_back(item); }
+  const std::vector<T>& GetItems() const { return m_items; }
+
+private:
+  std::vector<T> m_items;
+};
+
+using PVRChannelsResultSet = StubResultSet<PVRChannel>;
+using PVRChannelGroupsResultSet = StubResultSet<PVRChannelGroup>;
+using PVRChannelGroupMembersResultSet = StubResultSet<PVRChannelGroupMember>;
+using PVREPGTagsResultSet = StubResultSet<PVREPGTag>;
+using PVRRecordingsResultSet = StubResultSet<PVRRecording>;
+
+class CInstancePVRClient
+{
+public:
+  virtual ~CInstancePVRClient() = default;
+
+  virtual PVR_ERROR GetCapabilities(PVRCapabilities& capabilities) = 0;
+  virtual PVR_ERROR GetBackendName(std::string& name) = 0;
+  virtual PVR_ERROR GetBackendVersion(std::string& version) = 0;
+  virtual PVR_ERROR GetConnectionString(std::string& connection) { return PVR_ERROR_NOT_IMPLEMENTED; }
+  virtual PVR_ERROR GetDriveSpace(uint64_t& total, uint64_t& used) { return PVR_ERROR_NOT_IMPLEMENTED; }
+  virtual PVR_ERROR OnSystemWake() { return PVR_ERROR_NOT_IMPLEMENTED; }
+  virtual PVR_ERROR GetChannelsAmount(int& amount) { return PVR_ERROR_NOT_IMPLEMENTED; }
+  virtual PVR_ERROR GetChannels(bool radio, PVRChannelsResultSet& results) { return PVR_ERROR_NOT_IMPLEMENTED; }
+  virtual PVR_ERROR GetChannelStreamProperties(const PVRChannel& channel, PVR_SOURCE source, std::vector<PVRStreamProperty>& properties) { return PVR_ERROR_NOT_IMPLEMENTED; }
+  virtual PVR_ERROR GetSignalStatus(int channelUid, PVRSignalStatus& signalStatus) { return PVR_ERROR_NOT_IMPLEMENTED; }
+  virtual PVR_ERROR GetEPGForChannel(int channelUid, time_t start, time_t end, PVREPGTagsResultSet& results) { return PVR_ERROR_NOT_IMPLEMENTED; }
+  virtual PVR_ERROR GetChannelGroupsAmount(int& amount) { return PVR_ERROR_NOT_IMPLEMENTED; }
+  virtual PVR_ERROR GetChannelGroups(bool radio, PVRChannelGroupsResultSet& results) { return PVR_ERROR_NOT_IMPLEMENTED; }
+  virtual PVR_ERROR GetChannelGroupMembers(const PVRChannelGroup& group, PVRChannelGroupMembersResultSet& results) { return PVR_ERROR_NOT_IMPLEMENTED; }
+  virtual PVR_ERROR GetRecordingsAmount(bool deleted, int& amount) { return PVR_ERROR_NOT_IMPLEMENTED; }
+  virtual PVR_ERROR GetRecordings(bool deleted, PVRRecordingsResultSet& results) { return PVR_ERROR_NOT_IMPLEMENTED; }
+  virtual PVR_ERROR GetRecordingStreamProperties(const PVRRecording& recording, std::vector<PVRStreamProperty>& properties) { return PVR_ERROR_NOT_IMPLEMENTED; }
+  virtual bool OpenLiveStream(const PVRChannel& channel) { return false; }
+  virtual void CloseLiveStream() {}
+  virtual int ReadLiveStream(unsigned char* buffer, unsigned int size) { return -1; }
+  virtual int64_t SeekLiveStream(int64_t position, int whence) { return -1; }
+  virtual int64_t LengthLiveStream() { return -1; }
+  virtual bool CanPauseStream() { return false; }
+  virtual bool CanSeekStream() { return false; }
+  virtual bool IsRealTimeStream() { return true; }
+  virtual PVR_ERROR GetStreamTimes(PVRStreamTimes& times) { return PVR_ERROR_NOT_IMPLEMENTED; }
+
+  // Counted so the harness can report how often Kodi would have been notified
+  static void TriggerChannelUpdate() { s_nChannelUpdates++; }
+  static void TriggerChannelGroupsUpdate() { s_nChannelGroupsUpdates++; }
+  static void TriggerRecordingUpdate() { s_nRecordingUpdates++; }
+  void TriggerEpgUpdate(unsigned int channelUid) { s_nEpgUpdates++; }
+
+  static inline std::atomic<unsigned int> s_nChannelUpdates{0};
+  static inline std::atomic<unsigned int> s_nChannelGroupsUpdates{0};
+  static inline std::atomic<unsigned int> s_nRecordingUpdates{0};
+  static inline std::atomic<unsigned int> s_nEpgUpdates{0};
+};
+
+} // namespace addon
+} // namespace kodi
@@ -0,0 +1,26 @@
+/*
+ *  Copyright (C) 2015-2021 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2015 Zoltan Csizmadia (zcsizmadia@gmail.com)
+ *  Copyright (C) 2011 Pulse-Eight (https://www.pulse-eight.com)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <string>
+
+namespace kodi
+{
+namespace tools
+{
+
+class StringUtils
+{
+public:
+  static std::string Format(const char* fmt, ...);
+};
+
+} // namespace tools
+} // namespace kodi